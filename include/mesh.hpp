@@ -3,23 +3,191 @@
 
 // Mesh data structure
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <span>
+
+using idx_t = uint32_t;
+
+struct vec2f
+{
+    float u, v;
+};
+struct vec3f
+{
+    float x, y, z;
+};
+// One face corner: position, texcoord and normal indices (0-based), each
+// Mesh::npos when the corner does not reference one.
+struct vec3i
+{
+    idx_t i, j, k;
+};
+
+// Geometry of one import batch, in file order. Face corners index the
+// whole mesh, not the chunk.
+struct MeshChunk
+{
+    std::span<const vec3f> positions;
+    std::span<const vec2f> texcoords;
+    std::span<const vec3f> normals;
+    std::span<const vec3i> faceVertices;
+    std::span<const idx_t> faceSizes;
+};
+
+enum class MeshImportEngine
+{
+    Pipeline,    // one producer hands batches to consumers through a queue
+    TwoPhase,    // every thread counts, then scans offsets, then parses
+    WorkStealing // per-thread deques of batch ranges, idle threads steal
+};
+
+// How importObj(path) reads the file.
+enum class MeshImportIo
+{
+    Mmap, // map the file and parse it in place
+    Read  // large reads into a ring of buffers, overlapping I/O and parsing
+};
+
+// Tuning for Mesh::importObj. Fields left at 0 are picked per import from
+// the file size, the CPUs this process may run on (sched_getaffinity) and
+// a memory bandwidth probe that runs once per process.
+struct MeshImportOptions
+{
+    MeshImportEngine engine = MeshImportEngine::Pipeline;
+    std::size_t batchSize = 0;     // bytes per batch, cut at a newline
+    std::size_t numThreads = 0;    // parsing threads
+    std::size_t queueCapacity = 0; // Pipeline queue slots
+
+    // Gather the geometry into contiguous arrays after import.
+    bool merge = true;
+
+    // Bytes of a file kept resident while importing; 0 maps it whole.
+    // A window streams the file through the Pipeline engine (whatever
+    // engine is set), dropping pages once their batches are parsed, so
+    // peak memory follows the window and the output rather than the input.
+    std::size_t streamWindow = 0;
+
+    // Read uses io_uring when built with liburing (MESH_HAVE_LIBURING) and
+    // pread threads otherwise, and always runs the Pipeline engine. Each
+    // ring buffer holds readBufferSize bytes (0 = auto); a line longer than
+    // a quarter of that fails the import. directIo opens the file with
+    // O_DIRECT where the filesystem supports it.
+    MeshImportIo io = MeshImportIo::Mmap;
+    std::size_t readBufferSize = 0;
+    bool directIo = false;
+
+    // Directory of saveBinary files that importObj(path) reuses instead of
+    // parsing again, keyed on the file's device, inode, size and mtime. A
+    // miss parses as usual and then adds an entry; nullptr disables it.
+    // Entries for files that changed are not removed.
+    const char* cacheDir = nullptr;
+
+    // Pipeline threads spin, then yield, then park while the queue is
+    // empty or full.
+    std::size_t spinIterations = 4096;
+    std::size_t yieldIterations = 16;
+    bool park = true;
+
+    // Print a performance report to stdout after each import.
+    bool printStats = true;
+};
+
+// Formatting for Mesh::exportObj.
+struct MeshExportOptions
+{
+    // Digits after the decimal point for every coordinate (at most 9), or
+    // -1 for the shortest text that reads back as the same float. Fixed
+    // precision formats several times faster.
+    int precision = -1;
+};
 
 class _MeshImpl;
+class ThreadPool;
 
 class Mesh
 {
 public:
+    static constexpr idx_t npos = static_cast<idx_t>(-1);
+
+    // Runs its work on ThreadPool::global().
     Mesh();
+    // Runs its work on pool, which must outlive this Mesh.
+    explicit Mesh(ThreadPool& pool);
     ~Mesh();
 
-    // Imports an OBJ file into this Mesh.
+    // Imports an OBJ file into this Mesh. gzip and zstd compressed files
+    // and spans are decompressed on the fly when built with zlib or zstd.
     // Returns false on failure.
-    bool importObj(const char* path);
+    bool importObj(const char* path, const MeshImportOptions& options = {});
+    // Imports OBJ text already in memory, parsed in place. data only has to
+    // outlive the call.
+    bool importObj(std::span<const char> data, const MeshImportOptions& options = {});
+    // Imports from an open descriptor, which stays open. Regular files are
+    // read from offset 0 like a path; pipes and sockets are read to end of
+    // file through the read ring whatever options.io says.
+    bool importObj(int fd, const MeshImportOptions& options = {});
+    // Imports a binary little-endian PLY file: vertex x/y/z and, when
+    // present, nx/ny/nz and s/t (or u/v) become positions, normals and
+    // texcoords, and each face corner references all three through its
+    // vertex_indices entry. Uses numThreads, batchSize and printStats.
+    // Returns false on failure.
+    bool importPly(const char* path, const MeshImportOptions& options = {});
 
     // Exports this Mesh as an OBJ file.
     // Returns false on failure.
-    bool exportObj(const char* path) const;
+    bool exportObj(const char* path, const MeshExportOptions& options = {}) const;
+    // Exports positions and faces as binary little-endian PLY. Texcoords
+    // and normals are indexed per corner here, which PLY vertices cannot
+    // express, so they are left out.
+    // Returns false on failure.
+    bool exportPly(const char* path) const;
+    // Exports the faces as binary STL, fanning faces with more than three
+    // corners into triangles with normals computed from their corners.
+    // Returns false on failure, including meshes of over 2^32 triangles.
+    bool exportStl(const char* path) const;
+    // Exports a binary glTF 2.0 file with one triangle mesh. Corners that
+    // share position, texcoord and normal become one interleaved vertex.
+    // Normals are written only if every corner has a nonzero one.
+    // Returns false on failure, including meshes without triangles or too
+    // large for GLB's 4 GiB limit.
+    bool exportGlb(const char* path) const;
+
+    // Writes this Mesh to a binary cache file that loadBinary maps back in
+    // far faster than an OBJ parses. The file is little-endian and only
+    // readable by a build with the same format version.
+    // Returns false on failure.
+    bool saveBinary(const char* path) const;
+    // Replaces this Mesh with a saveBinary file. The file is mapped, not
+    // read: the views below point into it and fault pages in on access.
+    // Returns false, leaving this Mesh as it was, if the file is not a
+    // valid cache.
+    bool loadBinary(const char* path);
+
+    // Views into the internal storage. They stay valid until the next
+    // import or load into, or destruction of, this Mesh.
+
+    // True when the whole mesh sits in single arrays (the default after
+    // import). The whole-mesh views below are empty otherwise; use chunk().
+    bool isContiguous() const;
+
+    std::span<const vec3f> positions() const;
+    std::span<const vec2f> texcoords() const;
+    std::span<const vec3f> normals() const;
+    // Corners of every face back to back; faceSizes() splits them.
+    std::span<const vec3i> faceVertices() const;
+    std::span<const idx_t> faceSizes() const;
+
+    std::size_t numPositions() const;
+    std::size_t numTexcoords() const;
+    std::size_t numNormals() const;
+    std::size_t numFaces() const;
+    std::size_t numFaceVertices() const;
+
+    // Per-batch views, available whether or not the mesh is contiguous.
+    std::size_t numChunks() const;
+    MeshChunk chunk(std::size_t i) const;
 
 private:
     std::unique_ptr<_MeshImpl> _impl;
@@ -2,7 +2,16 @@
 #define SPMC_QUEUE_HPP
 
 #include <atomic>
+#include <cstdint>
 #include <stdexcept>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SPMC_PAUSE() _mm_pause()
+#else
+#define SPMC_PAUSE() std::this_thread::yield()
+#endif
 
 #ifndef CACHE_LINE_SIZE
 #define CACHE_LINE_SIZE 64
@@ -26,6 +35,16 @@ static inline std::size_t spmc_next_pow2(std::size_t x)
     return x + 1;
 }
 
+// How the blocking push/pop wait: spin with pause for spin_iterations
+// rounds, then yield for yield_iterations rounds, then park on a futex
+// (std::atomic::wait) until the other side makes progress.
+struct spmc_wait_policy
+{
+    std::size_t spin_iterations = 4096;
+    std::size_t yield_iterations = 16;
+    bool park = true; // false keeps yielding instead of parking
+};
+
 template <class T>
 class alignas(CACHE_LINE_SIZE) SPMCQueue
 {
@@ -80,9 +99,28 @@ public:
         slot.data = item;
         slot.sequence.store(producer_index + 1, std::memory_order_release);
         mWriteIndex.store(producer_index + 1, std::memory_order_release);
+        wake(mPushEpoch, mPopWaiters);
         return true;
     }
 
+    // Blocking. Returns false only if the queue is closed.
+    bool push(const T& item, const spmc_wait_policy& policy = {})
+    {
+        for (std::size_t round = 0;; ++round)
+        {
+            if (try_push(item))
+            {
+                return true;
+            }
+            if (mClosed.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            backoff(round, policy, mPopEpoch, mPushWaiters,
+                [this]() { return writable() || mClosed.load(std::memory_order_acquire); });
+        }
+    }
+
     // Non-blocking. Returns false if empty.
     bool try_pop(T& out)
     {
@@ -103,6 +141,7 @@ public:
                 {
                     out = slot.data;
                     slot.sequence.store(consumer_index + mCapacity, std::memory_order_release);
+                    wake(mPopEpoch, mPushWaiters);
                     return true;
                 }
                 continue;
@@ -117,12 +156,93 @@ public:
         }
     }
 
+    // Blocking. Returns false once the queue is closed and drained.
+    bool pop(T& out, const spmc_wait_policy& policy = {})
+    {
+        for (std::size_t round = 0;; ++round)
+        {
+            if (try_pop(out))
+            {
+                return true;
+            }
+            if (mClosed.load(std::memory_order_acquire) && !readable())
+            {
+                return false;
+            }
+            backoff(round, policy, mPushEpoch, mPopWaiters,
+                [this]() { return readable() || mClosed.load(std::memory_order_acquire); });
+        }
+    }
+
+    // Fails further pushes and releases every blocked caller.
+    void close()
+    {
+        mClosed.store(true, std::memory_order_release);
+        mPushEpoch.fetch_add(1, std::memory_order_release);
+        mPopEpoch.fetch_add(1, std::memory_order_release);
+        mPushEpoch.notify_all();
+        mPopEpoch.notify_all();
+    }
+
     std::size_t capacity() const
     {
         return mCapacity;
     }
 
 private:
+    bool writable() const
+    {
+        const std::size_t producer_index = mWriteIndex.load(std::memory_order_relaxed);
+        return mSlots[producer_index & mIndexMask].sequence.load(std::memory_order_acquire) ==
+            producer_index;
+    }
+
+    bool readable() const
+    {
+        const std::size_t consumer_index = mReadIndex.load(std::memory_order_relaxed);
+        return mSlots[consumer_index & mIndexMask].sequence.load(std::memory_order_acquire) ==
+            consumer_index + 1;
+    }
+
+    // Eventcount: a waiter reads the epoch, registers, re-checks, then
+    // parks until the epoch moves; the other side bumps the epoch only when
+    // someone is registered, so the uncontended path never enters the
+    // kernel.
+    template <class Ready>
+    static void backoff(std::size_t round, const spmc_wait_policy& policy,
+        std::atomic<std::uint32_t>& epoch, std::atomic<std::uint32_t>& waiters, Ready ready)
+    {
+        if (round < policy.spin_iterations)
+        {
+            SPMC_PAUSE();
+            return;
+        }
+        if (!policy.park || round < policy.spin_iterations + policy.yield_iterations)
+        {
+            std::this_thread::yield();
+            return;
+        }
+
+        const std::uint32_t seen = epoch.load(std::memory_order_acquire);
+        waiters.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!ready())
+        {
+            epoch.wait(seen, std::memory_order_acquire);
+        }
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    static void wake(std::atomic<std::uint32_t>& epoch, std::atomic<std::uint32_t>& waiters)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) > 0)
+        {
+            epoch.fetch_add(1, std::memory_order_release);
+            epoch.notify_all();
+        }
+    }
+
     struct alignas(CACHE_LINE_SIZE) Slot
     {
         std::atomic<std::size_t> sequence;
@@ -137,6 +257,12 @@ private:
 
     std::atomic<bool> mClosed{false};
 
+    // Bumped by a push (resp. pop) when consumers (resp. the producer) park.
+    alignas(CACHE_LINE_SIZE) std::atomic<std::uint32_t> mPushEpoch{0};
+    std::atomic<std::uint32_t> mPopWaiters{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<std::uint32_t> mPopEpoch{0};
+    std::atomic<std::uint32_t> mPushWaiters{0};
+
     alignas(CACHE_LINE_SIZE) Slot* mSlots;
 };
 
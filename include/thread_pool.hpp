@@ -0,0 +1,153 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Persistent fork-join pool. Workers sleep on a condition variable between
+// jobs, so repeated imports and exports pay no thread creation cost.
+class ThreadPool
+{
+public:
+    // Starts num_threads warm workers; more are added on demand.
+    explicit ThreadPool(std::size_t num_threads = 0)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (std::size_t i = 0; i < num_threads; ++i)
+        {
+            mWorkers.emplace_back([this]() { workerLoop(); });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mWake.notify_all();
+        for (auto& t : mWorkers)
+        {
+            t.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Process-wide pool with one warm worker per hardware thread.
+    static ThreadPool& global()
+    {
+        static ThreadPool pool(std::thread::hardware_concurrency());
+        return pool;
+    }
+
+    // Runs fn(tid) for every tid in [0, n) and returns once all are done.
+    // The caller runs tid 0. Every other tid gets its own thread, growing
+    // the pool if too few workers are idle, so the tasks may wait on one
+    // another (e.g. a producer and its consumers).
+    template <class F>
+    void run(std::size_t n, F&& fn)
+    {
+        if (n <= 1)
+        {
+            if (n == 1)
+            {
+                fn(std::size_t{0});
+            }
+            return;
+        }
+
+        using Fn = std::remove_reference_t<F>;
+        Job job;
+        job.remaining = n - 1;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mPending += n - 1;
+            while (mWorkers.size() - mBusy < mPending)
+            {
+                mWorkers.emplace_back([this]() { workerLoop(); });
+            }
+            for (std::size_t tid = 1; tid < n; ++tid)
+            {
+                mTasks.push_back(Task{
+                    [](void* ctx, std::size_t t) { (*static_cast<Fn*>(ctx))(t); },
+                    const_cast<void*>(static_cast<const void*>(&fn)), tid, &job});
+            }
+        }
+        mWake.notify_all();
+
+        fn(std::size_t{0});
+
+        std::unique_lock<std::mutex> lock(job.mutex);
+        job.done.wait(lock, [&job]() { return job.remaining == 0; });
+    }
+
+    std::size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mWorkers.size();
+    }
+
+private:
+    struct Job
+    {
+        std::mutex mutex;
+        std::condition_variable done;
+        std::size_t remaining;
+    };
+
+    struct Task
+    {
+        void (*invoke)(void*, std::size_t);
+        void* ctx;
+        std::size_t tid;
+        Job* job;
+    };
+
+    void workerLoop()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        for (;;)
+        {
+            mWake.wait(lock, [this]() { return mStop || !mTasks.empty(); });
+            if (mTasks.empty())
+            {
+                return; // stopping
+            }
+
+            const Task task = mTasks.front();
+            mTasks.pop_front();
+            --mPending;
+            ++mBusy;
+            lock.unlock();
+
+            task.invoke(task.ctx, task.tid);
+            {
+                std::lock_guard<std::mutex> job_lock(task.job->mutex);
+                if (--task.job->remaining == 0)
+                {
+                    task.job->done.notify_one();
+                }
+            }
+
+            lock.lock();
+            --mBusy;
+        }
+    }
+
+    mutable std::mutex mMutex;
+    std::condition_variable mWake;
+    std::deque<Task> mTasks;
+    std::vector<std::thread> mWorkers;
+    std::size_t mPending = 0; // queued tasks not yet picked up
+    std::size_t mBusy = 0;    // workers running a task
+    bool mStop = false;
+};
+
+#endif // THREAD_POOL_HPP
@@ -0,0 +1,111 @@
+#ifndef WS_DEQUE_HPP
+#define WS_DEQUE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+#include "spmc_queue.hpp"
+
+// Chase-Lev work-stealing deque (Le et al., "Correct and Efficient
+// Work-Stealing for Weak Memory Models"). The owning thread pushes and pops
+// at the bottom; any other thread steals from the top. Capacity is fixed.
+template <class T>
+class alignas(CACHE_LINE_SIZE) WSDeque
+{
+    static_assert(std::is_trivially_copyable_v<T>,
+        "WSDeque<T> requires T to be trivially copyable");
+
+public:
+    explicit WSDeque(std::size_t capacity)
+        : mCapacity(spmc_next_pow2(capacity)),
+          mIndexMask(mCapacity - 1),
+          mSlots(std::make_unique<std::atomic<T>[]>(mCapacity))
+    {
+    }
+
+    WSDeque(const WSDeque&) = delete;
+    WSDeque& operator=(const WSDeque&) = delete;
+
+    // Owner only. Returns false if full.
+    bool push(const T& item)
+    {
+        const std::int64_t b = mBottom.load(std::memory_order_relaxed);
+        const std::int64_t t = mTop.load(std::memory_order_acquire);
+        if (b - t >= static_cast<std::int64_t>(mCapacity))
+        {
+            return false;
+        }
+        mSlots[static_cast<std::size_t>(b) & mIndexMask].store(item, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        mBottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Owner only. Returns false if empty.
+    bool pop(T& out)
+    {
+        const std::int64_t b = mBottom.load(std::memory_order_relaxed) - 1;
+        mBottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = mTop.load(std::memory_order_relaxed);
+
+        if (t > b)
+        {
+            mBottom.store(b + 1, std::memory_order_relaxed);
+            return false; // empty
+        }
+
+        out = mSlots[static_cast<std::size_t>(b) & mIndexMask].load(std::memory_order_relaxed);
+        if (t == b)
+        {
+            // Last item: race the thieves for it.
+            const bool won = mTop.compare_exchange_strong(
+                t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            mBottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // Any thread. Returns false if empty or if another thread won the race.
+    bool steal(T& out)
+    {
+        std::int64_t t = mTop.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const std::int64_t b = mBottom.load(std::memory_order_acquire);
+        if (t >= b)
+        {
+            return false; // empty
+        }
+
+        out = mSlots[static_cast<std::size_t>(t) & mIndexMask].load(std::memory_order_relaxed);
+        return mTop.compare_exchange_strong(
+            t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    // Approximate when other threads are active.
+    bool empty() const
+    {
+        const std::int64_t t = mTop.load(std::memory_order_acquire);
+        const std::int64_t b = mBottom.load(std::memory_order_acquire);
+        return t >= b;
+    }
+
+    std::size_t capacity() const
+    {
+        return mCapacity;
+    }
+
+private:
+    const std::size_t mCapacity;
+    const std::size_t mIndexMask;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<std::int64_t> mTop{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<std::int64_t> mBottom{0};
+
+    alignas(CACHE_LINE_SIZE) std::unique_ptr<std::atomic<T>[]> mSlots;
+};
+
+#endif // WS_DEQUE_HPP
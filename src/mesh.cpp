@@ -5,26 +5,53 @@
 // imports
 // ==============================
 #include <algorithm>
+#include <array>
 #include <atomic>
+#include <barrier>
+#include <bit>
+#include <cerrno>
 #include <charconv>
 #include <chrono>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <fcntl.h>
 #include <immintrin.h>
 #include <iomanip>
 #include <iostream>
 #include <limits>
+#include <mutex>
+#include <numeric>
+#include <sched.h>
+#include <string>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <thread>
 #include <unistd.h>
 #include <vector>
 
 #include "../include/spmc_queue.hpp"
+#include "../include/thread_pool.hpp"
+#include "../include/ws_deque.hpp"
 #include "../thirdparty/fast_float/fast_float.h"
 
+#ifdef MESH_HAVE_LIBURING
+#include <liburing.h>
+#endif
+#ifdef MESH_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef MESH_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
 // ==============================
 // performance metrics
 // ==============================
@@ -35,6 +62,7 @@ inline uint64_t rdtsc() {
   return ((uint64_t)hi << 32) | lo;
 }
 
+// Counters for one import, reset when the next one starts.
 struct PerfMetrics {
   std::atomic<uint64_t> total_cycles{0};
   std::atomic<uint64_t> bytes_processed{0};
@@ -42,44 +70,127 @@ struct PerfMetrics {
   std::atomic<uint64_t> wait_cycles{0};
   std::atomic<uint64_t> parse_cycles{0};
   std::atomic<uint64_t> alloc_time_ns{0};
+
+  void reset() {
+    total_cycles = 0;
+    bytes_processed = 0;
+    lines_processed = 0;
+    wait_cycles = 0;
+    parse_cycles = 0;
+    alloc_time_ns = 0;
+  }
 };
-static PerfMetrics g_perf;
 
 // ==============================
 // constants + basic types
 // ==============================
-using idx_t = uint32_t;
-static constexpr idx_t sentinel = std::numeric_limits<idx_t>::max();
+static constexpr idx_t sentinel = Mesh::npos;
+
+// Leaves elements default-initialized on resize, so buffers that are about
+// to be overwritten are not zeroed first.
+template <class T> struct default_init_allocator : std::allocator<T> {
+  template <class U> struct rebind {
+    using other = default_init_allocator<U>;
+  };
+  default_init_allocator() = default;
+  template <class U>
+  default_init_allocator(const default_init_allocator<U> &) noexcept {}
 
-struct vec2f {
-  float u, v;
+  template <class U> void construct(U *p) { ::new (static_cast<void *>(p)) U; }
+  template <class U, class... Args> void construct(U *p, Args &&...args) {
+    ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...);
+  }
 };
-struct vec3f {
-  float x, y, z;
+template <class T> using buffer = std::vector<T, default_init_allocator<T>>;
+
+struct consumer_store {
+  buffer<vec3f> vertices;
+  buffer<vec2f> textures;
+  buffer<vec3f> normals;
+  buffer<vec3i> face_tape;
+  buffer<idx_t> face_bounds;
+  buffer<std::size_t> fixups; // face_tape slots (3 * corner + field)
 };
-struct vec3i {
-  idx_t i, j, k;
+
+// Appends into a reserved [pos, limit) slice of a preallocated array;
+// size() is the global position, so artifact ranges come out global.
+template <class T> struct slice_cursor {
+  T *data;
+  std::size_t pos, limit;
+  bool overflow;
+
+  void push_back(const T &x) {
+    if (pos < limit) {
+      data[pos++] = x;
+    } else {
+      overflow = true;
+    }
+  }
+  std::size_t size() const { return pos; }
 };
 
-struct consumer_store {
-  std::vector<vec3f> vertices;
-  std::vector<vec2f> textures;
-  std::vector<vec3f> normals;
-  std::vector<vec3i> face_tape;
-  std::vector<idx_t> face_bounds;
+// One batch's window into a preallocated, file-ordered consumer_store.
+struct slice_store {
+  slice_cursor<vec3f> vertices;
+  slice_cursor<vec2f> textures;
+  slice_cursor<vec3f> normals;
+  slice_cursor<vec3i> face_tape;
+  slice_cursor<idx_t> face_bounds;
+  slice_cursor<std::size_t> fixups;
+
+  bool overflowed() const {
+    return vertices.overflow || textures.overflow || normals.overflow ||
+           face_tape.overflow || face_bounds.overflow || fixups.overflow;
+  }
 };
 
 struct range {
   std::size_t begin, end;
 };
 
+struct consumer_sizes {
+  std::size_t v, t, n, ft, fb;
+};
+
+struct line_counts {
+  std::size_t v, t, n;
+};
+
+// Per-batch upper bounds on what the parser emits; exact for well-formed
+// input.
+struct batch_counts {
+  line_counts lines;
+  std::size_t faces, corners;
+
+  batch_counts &operator+=(const batch_counts &o) {
+    lines.v += o.lines.v;
+    lines.t += o.lines.t;
+    lines.n += o.lines.n;
+    faces += o.faces;
+    corners += o.corners;
+    return *this;
+  }
+};
+
 struct mesh_config {
   std::size_t batch_size;
   std::size_t num_consumers;
   std::size_t queue_capacity;
+  MeshImportEngine mode;
+  bool merge; // gather the consumer stores into one after import
+  std::size_t stream_window; // resident input bytes, 0 = whole file
+  spmc_wait_policy wait; // how pipeline threads wait on the queue
+  bool print_stats;
 };
 
-enum class LineType { Vertex, Texture, Normal, Face, Unknown };
+enum class LineType : uint8_t {
+  Vertex,
+  Texture,
+  Normal,
+  Face,
+  Indented,
+  Unknown
+};
 
 struct object {
   LineType type;
@@ -92,14 +203,41 @@ struct batch {
   std::size_t size;
   std::size_t batch_id;
   std::size_t v_seen, t_seen, n_seen;
+  bool deferred; // *_seen unknown, relative indices resolved after join
+};
+
+// Completion flags for a streamed import. Consumers flag each parsed batch
+// and bump completed; the producer waits on completed while its window is
+// full.
+struct stream_state {
+  std::unique_ptr<std::atomic<bool>[]> done;
+  std::atomic<std::size_t> completed{0};
+
+  explicit stream_state(std::size_t max_batches)
+      : done(std::make_unique<std::atomic<bool>[]>(max_batches)) {}
+
+  void finish(std::size_t batch_id) {
+    done[batch_id].store(true, std::memory_order_release);
+    completed.fetch_add(1, std::memory_order_release);
+    completed.notify_one();
+  }
 };
 static constexpr batch *batch_sentinel = nullptr;
 
-struct batch_artifact {
+struct alignas(CACHE_LINE_SIZE) batch_artifact {
   std::size_t batch_id;
   std::size_t consumer_id;
-  range v, t, n, ft, fb;
-  std::size_t padA, padB, padC, padD;
+  range v, t, n, ft, fb, fx;
+  line_counts lines; // v/vt/vn lines seen in the batch
+};
+
+// Read-only arrays of one consumer_store, or of a loadBinary mapping.
+struct store_view {
+  std::span<const vec3f> vertices;
+  std::span<const vec2f> textures;
+  std::span<const vec3f> normals;
+  std::span<const vec3i> face_tape;
+  std::span<const idx_t> face_bounds;
 };
 
 // ==============================
@@ -180,9 +318,39 @@ inline idx_t normalizeIndex(long idx, std::size_t seen) {
   return sentinel;
 }
 
-inline bool flushFd(int fd, std::string &out) {
-  const char *p = out.data();
-  std::size_t n = out.size();
+// A relative index in a deferred batch is resolved against the batch-local
+// count and its tape slot is queued so the batch base can be added later.
+// The tape holds the batch-local result as an int32_t until then, so an
+// index reaching back more than 2^31 elements resolves to sentinel.
+template <class Store>
+inline idx_t resolveIndex(long idx, std::size_t seen, bool deferred,
+                          std::size_t slot, Store &store) {
+  if (idx < 0 && deferred) {
+    const long rel = static_cast<long>(seen) + idx;
+    if (rel < std::numeric_limits<int32_t>::min()) {
+      return sentinel;
+    }
+    store.fixups.push_back(slot);
+    return static_cast<idx_t>(static_cast<int32_t>(rel));
+  }
+  return normalizeIndex(idx, seen);
+}
+
+// Runs fn(i) for i in [0, n) on up to num_threads pool threads, handing
+// indices out dynamically.
+template <class F>
+void parallelFor(ThreadPool &pool, std::size_t num_threads, std::size_t n,
+                 F &&fn) {
+  std::atomic<std::size_t> next{0};
+  pool.run(std::min(num_threads, n), [&](std::size_t) {
+    for (std::size_t i = next++; i < n; i = next++) {
+      fn(i);
+    }
+  });
+}
+
+inline bool writeFull(int fd, const void *data, std::size_t n) {
+  const char *p = static_cast<const char *>(data);
   while (n) {
     ssize_t w = ::write(fd, p, n);
     if (w <= 0) {
@@ -191,78 +359,124 @@ inline bool flushFd(int fd, std::string &out) {
     p += static_cast<std::size_t>(w);
     n -= static_cast<std::size_t>(w);
   }
-  out.clear();
   return true;
 }
 
-inline void appendU64(std::string &out, std::size_t v) {
-  char buf[32];
-  auto r = std::to_chars(buf, buf + sizeof(buf), v);
-  out.append(buf, static_cast<std::size_t>(r.ptr - buf));
+// Writes all of iov; a buffer cut short by a partial writev is finished
+// with write().
+inline bool writevFull(int fd, const iovec *iov, std::size_t n) {
+  while (n) {
+    const ssize_t w =
+        ::writev(fd, iov, static_cast<int>(std::min<std::size_t>(n, IOV_MAX)));
+    if (w <= 0) {
+      return false;
+    }
+    std::size_t done = static_cast<std::size_t>(w);
+    for (; n && done >= iov->iov_len; ++iov, --n) {
+      done -= iov->iov_len;
+    }
+    if (done) {
+      if (!writeFull(fd, static_cast<const char *>(iov->iov_base) + done,
+                     iov->iov_len - done)) {
+        return false;
+      }
+      ++iov;
+      --n;
+    }
+  }
+  return true;
+}
+
+// The write* formatters below need kMaxFloatChars free bytes at dst and
+// return the end of what they wrote.
+static constexpr std::size_t kMaxFloatChars = 64;
+
+inline char *writeU64(char *dst, std::size_t v) {
+  return std::to_chars(dst, dst + 20, v).ptr;
 }
 
-inline void appendF32(std::string &out, float v) {
-  char buf[64];
-  auto r = std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::general);
+inline char *writeF32(char *dst, float v) {
+  auto r = std::to_chars(dst, dst + kMaxFloatChars, v,
+                         std::chars_format::general);
   if (r.ec != std::errc()) {
-    out += "0";
-    return;
+    *dst = '0';
+    return dst + 1;
   }
-  out.append(buf, static_cast<std::size_t>(r.ptr - buf));
+  return r.ptr;
 }
 
-// ==============================
-// producer utils
-// ==============================
-struct ring_buffer {
-  explicit ring_buffer(std::size_t capacity) : buf(capacity), cap(capacity) {}
-  std::vector<batch *> buf;
-  const std::size_t cap;
-  std::size_t head = 0, tail = 0, count = 0;
+// "00" to "99", for writing two digits at a time.
+static constexpr std::array<char, 200> kDigitPairs = []() {
+  std::array<char, 200> t{};
+  for (int i = 0; i < 100; ++i) {
+    t[2 * i] = static_cast<char>('0' + i / 10);
+    t[2 * i + 1] = static_cast<char>('0' + i % 10);
+  }
+  return t;
+}();
 
-  bool empty() const { return count == 0; }
-  bool full() const { return count == cap; }
-  std::size_t size() const { return count; }
+static constexpr uint64_t kPow10[] = {1,         10,        100,     1000,
+                                      10000,     100000,    1000000, 10000000,
+                                      100000000, 1000000000};
 
-  void push(batch *r) {
-    buf[tail] = r;
-    tail = (tail + 1) % cap;
-    ++count;
+// Writes the n low decimal digits of v, zero padded, backwards from end.
+inline char *writeDigitsBack(char *end, uint64_t v, unsigned n) {
+  for (; n >= 2; n -= 2) {
+    end -= 2;
+    std::memcpy(end, &kDigitPairs[2 * (v % 100)], 2);
+    v /= 100;
   }
-  batch *front() const { return buf[head]; }
-  void pop() {
-    head = (head + 1) % cap;
-    --count;
+  if (n) {
+    *--end = static_cast<char>('0' + v % 10);
   }
+  return end;
+}
 
-  void drain_to(SPMCQueue<batch *> &queue) {
-    while (!empty()) {
-      if (!queue.try_push(front())) {
-        break;
-      }
-      pop();
+// Same text as std::to_chars(chars_format::fixed, precision) for precision
+// <= 9. The float times 10^precision is exact in a double (5^9 needs 21 bits
+// on top of the 24-bit significand), so one ties-to-even conversion rounds
+// it like the exact decimal would be.
+inline char *writeFixed(char *dst, float v, unsigned precision) {
+  const double scaled = std::fabs(static_cast<double>(v)) * kPow10[precision];
+  if (!(scaled < 0x1p53)) { // also NaN and infinity
+    auto r = std::to_chars(dst, dst + kMaxFloatChars, v,
+                           std::chars_format::fixed, precision);
+    if (r.ec != std::errc()) {
+      *dst = '0';
+      return dst + 1;
     }
+    return r.ptr;
   }
-};
 
-struct LineCursor {
-  const char *base;
-  std::size_t size;
-  std::size_t i = 0;
-
-  bool next(const char *&p, const char *&e) {
-    if (i >= size) {
-      return false;
-    }
-    p = base + i;
-    const char *nl = static_cast<const char *>(std::memchr(p, '\n', size - i));
-    std::size_t len = nl ? static_cast<std::size_t>(nl - p) : (size - i);
-    e = p + len;
-    i += len + (nl ? 1 : 0);
-    return true;
+  const uint64_t q = static_cast<uint64_t>(_mm_cvtsd_si64(_mm_set_sd(scaled)));
+  uint64_t ip = q / kPow10[precision];
+  char buf[32];
+  char *const end = buf + sizeof(buf);
+  char *p = end;
+  if (precision) {
+    p = writeDigitsBack(p, q % kPow10[precision], precision);
+    *--p = '.';
   }
-};
+  for (; ip >= 100; ip /= 100) {
+    p -= 2;
+    std::memcpy(p, &kDigitPairs[2 * (ip % 100)], 2);
+  }
+  if (ip >= 10) {
+    p -= 2;
+    std::memcpy(p, &kDigitPairs[2 * ip], 2);
+  } else {
+    *--p = static_cast<char>('0' + ip);
+  }
+  if (std::signbit(v)) {
+    *--p = '-';
+  }
+  std::memcpy(dst, p, static_cast<std::size_t>(end - p));
+  return dst + (end - p);
+}
 
+// ==============================
+// producer utils
+// ==============================
 inline range build_range(const char *data, std::size_t file_size,
                          std::size_t &offset, std::size_t batch_size) {
   const std::size_t begin = offset;
@@ -310,33 +524,268 @@ inline void prefixCounts(const char *p, const char *e, std::size_t &v_seen,
   }
 }
 
+inline void countLine(const char *p, const char *e, batch_counts &c) {
+  p = skipWs(p, e);
+  if (e - p >= 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+    ++c.faces;
+    for (++p;;) {
+      p = skipWs(p, e);
+      if (p >= e) {
+        break;
+      }
+      ++c.corners;
+      while (p < e && *p != ' ' && *p != '\t') {
+        ++p;
+      }
+    }
+    return;
+  }
+  prefixCounts(p, e, c.lines.v, c.lines.t, c.lines.n);
+}
+
+// ==============================
+// simd scan
+// ==============================
+struct scan_state {
+  batch_counts counts;
+  uint64_t carry;    // 1 if the next block starts on a fresh line
+  uint64_t ws_carry; // 1 if the previous block ended on whitespace
+  unsigned char borrow; // 1 if the previous block ended inside a face line
+};
+
+// Bitmasks for one 64-byte block, bit i describing byte i of the block
+// (c0) or the byte 1 or 2 after it (c1, c2).
+struct block_masks {
+  uint64_t nl, v0, f0, ws0, ws1, ws2, t1, n1;
+};
+
+// Lines starting with whitespace are rare, so they take the scalar path.
+__attribute__((always_inline)) inline void
+countBlock(const block_masks &m, const char *p, const char *end,
+           scan_state &st) {
+  const uint64_t start = (m.nl << 1) | st.carry;
+  st.carry = m.nl >> 63;
+
+  const uint64_t vs = start & m.v0;
+  line_counts &lc = st.counts.lines;
+  lc.v += static_cast<std::size_t>(__builtin_popcountll(vs & m.ws1));
+  lc.t += static_cast<std::size_t>(__builtin_popcountll(vs & m.t1 & m.ws2));
+  lc.n += static_cast<std::size_t>(__builtin_popcountll(vs & m.n1 & m.ws2));
+
+  // Subtracting the face starts from the newline mask borrows from each 'f'
+  // up to its line's newline, so the xor marks every face line's bytes.
+  const uint64_t fs = start & m.f0 & m.ws1;
+  unsigned long long diff;
+  st.borrow = _subborrow_u64(st.borrow, m.nl, fs, &diff);
+  const uint64_t faces = diff ^ m.nl;
+  const uint64_t prev_ws = (m.ws0 << 1) | st.ws_carry;
+  st.ws_carry = m.ws0 >> 63;
+  const uint64_t tokens = ~m.ws0 & ~m.nl & prev_ws;
+  st.counts.faces += static_cast<std::size_t>(__builtin_popcountll(fs));
+  st.counts.corners +=
+      static_cast<std::size_t>(__builtin_popcountll(tokens & faces));
+
+  uint64_t lead = start & m.ws0;
+  while (lead) {
+    const char *q = p + __builtin_ctzll(lead);
+    const char *nl = static_cast<const char *>(
+        std::memchr(q, '\n', static_cast<std::size_t>(end - q)));
+    countLine(q, nl ? nl : end, st.counts);
+    lead &= lead - 1;
+  }
+}
+
+// Each kernel consumes nblocks * 64 bytes and may read 2 bytes past them.
+using scan_kernel = void (*)(const char *, std::size_t, const char *,
+                             scan_state &);
+
+__attribute__((target("avx2"), always_inline)) inline uint64_t
+eqMask64(__m256i lo, __m256i hi, __m256i c) {
+  const uint32_t a =
+      static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, c)));
+  const uint32_t b =
+      static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, c)));
+  return (static_cast<uint64_t>(b) << 32) | a;
+}
+
+__attribute__((target("avx2,popcnt,bmi"))) void
+scanBlocksAvx2(const char *p, std::size_t nblocks, const char *end,
+               scan_state &st) {
+  const __m256i nl = _mm256_set1_epi8('\n');
+  const __m256i sp = _mm256_set1_epi8(' ');
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i cv = _mm256_set1_epi8('v');
+  const __m256i ct = _mm256_set1_epi8('t');
+  const __m256i cn = _mm256_set1_epi8('n');
+  const __m256i cf = _mm256_set1_epi8('f');
+
+  for (std::size_t k = 0; k < nblocks; ++k, p += 64) {
+    const __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    const __m256i b0 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32));
+    const __m256i a1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 1));
+    const __m256i b1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 33));
+    const __m256i a2 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 2));
+    const __m256i b2 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 34));
+
+    block_masks m;
+    m.nl = eqMask64(a0, b0, nl);
+    m.v0 = eqMask64(a0, b0, cv);
+    m.f0 = eqMask64(a0, b0, cf);
+    m.ws0 = eqMask64(a0, b0, sp) | eqMask64(a0, b0, tab);
+    m.ws1 = eqMask64(a1, b1, sp) | eqMask64(a1, b1, tab);
+    m.ws2 = eqMask64(a2, b2, sp) | eqMask64(a2, b2, tab);
+    m.t1 = eqMask64(a1, b1, ct);
+    m.n1 = eqMask64(a1, b1, cn);
+    countBlock(m, p, end, st);
+  }
+}
+
+__attribute__((target("avx512f,avx512bw,popcnt,bmi"))) void
+scanBlocksAvx512(const char *p, std::size_t nblocks, const char *end,
+                 scan_state &st) {
+  const __m512i nl = _mm512_set1_epi8('\n');
+  const __m512i sp = _mm512_set1_epi8(' ');
+  const __m512i tab = _mm512_set1_epi8('\t');
+  const __m512i cv = _mm512_set1_epi8('v');
+  const __m512i ct = _mm512_set1_epi8('t');
+  const __m512i cn = _mm512_set1_epi8('n');
+  const __m512i cf = _mm512_set1_epi8('f');
+
+  for (std::size_t k = 0; k < nblocks; ++k, p += 64) {
+    const __m512i c0 = _mm512_loadu_si512(p);
+    const __m512i c1 = _mm512_loadu_si512(p + 1);
+    const __m512i c2 = _mm512_loadu_si512(p + 2);
+
+    block_masks m;
+    m.nl = _mm512_cmpeq_epi8_mask(c0, nl);
+    m.v0 = _mm512_cmpeq_epi8_mask(c0, cv);
+    m.f0 = _mm512_cmpeq_epi8_mask(c0, cf);
+    m.ws0 = _mm512_cmpeq_epi8_mask(c0, sp) | _mm512_cmpeq_epi8_mask(c0, tab);
+    m.ws1 = _mm512_cmpeq_epi8_mask(c1, sp) | _mm512_cmpeq_epi8_mask(c1, tab);
+    m.ws2 = _mm512_cmpeq_epi8_mask(c2, sp) | _mm512_cmpeq_epi8_mask(c2, tab);
+    m.t1 = _mm512_cmpeq_epi8_mask(c1, ct);
+    m.n1 = _mm512_cmpeq_epi8_mask(c1, cn);
+    countBlock(m, p, end, st);
+  }
+}
+
+inline scan_kernel selectScanKernel() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512bw")) {
+    return scanBlocksAvx512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return scanBlocksAvx2;
+  }
+  return nullptr;
+}
+static const scan_kernel g_scan_kernel = selectScanKernel();
+
+inline batch_counts scanCountsScalar(const char *data, std::size_t size) {
+  batch_counts c{};
+  std::size_t i = 0;
+  while (i < size) {
+    const char *p = data + i;
+    const char *nl =
+        static_cast<const char *>(std::memchr(p, '\n', size - i));
+    const char *e = nl ? nl : data + size;
+    countLine(p, e, c);
+    i = static_cast<std::size_t>(e - data) + 1;
+  }
+  return c;
+}
+
+// Counts the v/vt/vn lines, faces and face corners of a batch that starts
+// on a line boundary.
+inline batch_counts scanCounts(const char *data, std::size_t size) {
+  if (!g_scan_kernel) {
+    return scanCountsScalar(data, size);
+  }
+
+  scan_state st{};
+  st.carry = 1;
+  const char *end = data + size;
+  const std::size_t nblocks = (size >= 66) ? (size - 2) / 64 : 0;
+  g_scan_kernel(data, nblocks, end, st);
+
+  // Run the tail through the same kernel from a zero-padded copy.
+  const std::size_t done = nblocks * 64;
+  const std::size_t tail = size - done;
+  if (tail > 0) {
+    alignas(64) char buf[192] = {};
+    std::memcpy(buf, data + done, tail);
+    g_scan_kernel(buf, (tail + 63) / 64, buf + tail, st);
+  }
+  return st.counts;
+}
+
 // ==============================
 // consumer utils
 // ==============================
-inline LineType classifyLine(std::string_view line) {
-  std::size_t pos = 0;
-  std::string_view tok = nextToken(line, pos);
-  if (tok.empty()) {
-    return LineType::Unknown;
+// Maps the first two bytes of a line (little-endian) to its type. The
+// vt/vn keys also need whitespace in the third byte, see lookupLine.
+using line_table = std::array<LineType, 65536>;
+
+constexpr line_table buildLineTable() {
+  line_table t{};
+  t.fill(LineType::Unknown);
+  auto key = [](char a, char b) {
+    return static_cast<unsigned char>(a) |
+           (static_cast<unsigned>(static_cast<unsigned char>(b)) << 8);
+  };
+  for (char ws : {' ', '\t'}) {
+    t[key('v', ws)] = LineType::Vertex;
+    t[key('f', ws)] = LineType::Face;
   }
-  if (tok == "v") {
-    return LineType::Vertex;
+  t[key('v', 't')] = LineType::Texture;
+  t[key('v', 'n')] = LineType::Normal;
+  for (unsigned c = 0; c < 256; ++c) {
+    t[key(' ', static_cast<char>(c))] = LineType::Indented;
+    t[key('\t', static_cast<char>(c))] = LineType::Indented;
   }
-  if (tok == "vt") {
-    return LineType::Texture;
+  return t;
+}
+static constexpr line_table g_line_table = buildLineTable();
+
+// Keyword plus separator length by LineType.
+static constexpr unsigned char kKeywordSize[] = {2, 3, 3, 2, 0, 0};
+
+inline LineType lookupLine(const char *&p, const char *e) {
+  if (e - p < 2) {
+    return LineType::Unknown;
   }
-  if (tok == "vn") {
-    return LineType::Normal;
+  LineType type = g_line_table[static_cast<unsigned char>(p[0]) |
+                               (static_cast<unsigned>(
+                                    static_cast<unsigned char>(p[1]))
+                                << 8)];
+  if ((type == LineType::Texture || type == LineType::Normal) &&
+      (e - p < 3 || (p[2] != ' ' && p[2] != '\t'))) {
+    type = LineType::Unknown;
   }
-  if (tok == "f") {
-    return LineType::Face;
+  p += kKeywordSize[static_cast<unsigned>(type)];
+  return type;
+}
+
+// Classifies the line [p, e) and advances p past its keyword. Only
+// indented lines take a second lookup.
+inline LineType classifyLine(const char *&p, const char *e) {
+  LineType type = lookupLine(p, e);
+  if (type == LineType::Indented) [[unlikely]] {
+    p = skipWs(p, e);
+    type = lookupLine(p, e);
   }
-  return LineType::Unknown;
+  return type;
 }
 
+template <class Store>
 inline void parseFace(std::string_view s, std::size_t v_seen,
-                      std::size_t t_seen, std::size_t n_seen,
-                      consumer_store &store) {
+                      std::size_t t_seen, std::size_t n_seen, bool deferred,
+                      Store &store) {
   std::size_t pos = 0;
   std::size_t count = 0;
 
@@ -365,9 +814,16 @@ inline void parseFace(std::string_view s, std::size_t v_seen,
     long it = st.empty() ? 0 : parseLong(st, okt);
     long in = sn.empty() ? 0 : parseLong(sn, okn);
 
-    idx_t v = (sv.empty() || !okv) ? sentinel : normalizeIndex(iv, v_seen);
-    idx_t t = (st.empty() || !okt) ? sentinel : normalizeIndex(it, t_seen);
-    idx_t n = (sn.empty() || !okn) ? sentinel : normalizeIndex(in, n_seen);
+    const std::size_t slot = 3 * store.face_tape.size();
+    idx_t v = (sv.empty() || !okv)
+                  ? sentinel
+                  : resolveIndex(iv, v_seen, deferred, slot + 0, store);
+    idx_t t = (st.empty() || !okt)
+                  ? sentinel
+                  : resolveIndex(it, t_seen, deferred, slot + 1, store);
+    idx_t n = (sn.empty() || !okn)
+                  ? sentinel
+                  : resolveIndex(in, n_seen, deferred, slot + 2, store);
 
     store.face_tape.push_back(vec3i{v, t, n});
     ++count;
@@ -378,454 +834,3527 @@ inline void parseFace(std::string_view s, std::size_t v_seen,
   }
 }
 
-// ==============================
-// producer
-// ==============================
-void producerWork(SPMCQueue<batch *> &queue, const void *obj,
-                  std::size_t file_size, const mesh_config &config,
-                  batch *batches) {
-  ring_buffer backlog(std::max<std::size_t>(config.queue_capacity * 4, 64));
+// Byte classes of a 64-byte line window, one bit per byte.
+struct token_masks {
+  uint64_t ws;
+  uint64_t slash;
+  uint64_t dot;
+  uint64_t minus;
+  uint64_t digit;
+  uint64_t hash;
+};
 
-  const char *data = static_cast<const char *>(obj);
-  std::size_t offset = 0;
-  std::size_t batch_id = 0;
-  std::size_t v_seen = 0, t_seen = 0, n_seen = 0;
+// Each kernel reads exactly 64 bytes at p.
+using token_kernel = token_masks (*)(const char *);
 
-  while (offset < file_size || !backlog.empty()) {
-    if (!backlog.empty()) {
-      backlog.drain_to(queue);
-    }
+__attribute__((target("avx2"))) token_masks tokenMasksAvx2(const char *p) {
+  const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+  const __m256i hi =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32));
+  const __m256i zero = _mm256_set1_epi8('0');
+  const __m256i nine = _mm256_set1_epi8(9);
+  const __m256i dlo = _mm256_sub_epi8(lo, zero);
+  const __m256i dhi = _mm256_sub_epi8(hi, zero);
+  const uint32_t dl = static_cast<uint32_t>(_mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(_mm256_min_epu8(dlo, nine), dlo)));
+  const uint32_t dh = static_cast<uint32_t>(_mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(_mm256_min_epu8(dhi, nine), dhi)));
 
-    while (offset < file_size && !backlog.full()) {
-      range r = build_range(data, file_size, offset, config.batch_size);
+  token_masks m;
+  m.ws = eqMask64(lo, hi, _mm256_set1_epi8(' ')) |
+         eqMask64(lo, hi, _mm256_set1_epi8('\t'));
+  m.slash = eqMask64(lo, hi, _mm256_set1_epi8('/'));
+  m.dot = eqMask64(lo, hi, _mm256_set1_epi8('.'));
+  m.minus = eqMask64(lo, hi, _mm256_set1_epi8('-'));
+  m.digit = (static_cast<uint64_t>(dh) << 32) | dl;
+  m.hash = eqMask64(lo, hi, _mm256_set1_epi8('#'));
+  return m;
+}
 
-      const std::size_t id = batch_id++;
-      batch *b = &batches[id];
-      b->data = data + r.begin;
-      b->size = r.end - r.begin;
-      b->batch_id = id;
-      b->v_seen = v_seen;
-      b->t_seen = t_seen;
-      b->n_seen = n_seen;
+__attribute__((target("avx512f,avx512bw"))) token_masks
+tokenMasksAvx512(const char *p) {
+  const __m512i c = _mm512_loadu_si512(p);
 
-      LineCursor lc{data + r.begin, r.end - r.begin};
-      const char *p = nullptr, *e = nullptr;
-      while (lc.next(p, e)) {
-        prefixCounts(p, e, v_seen, t_seen, n_seen);
-      }
+  token_masks m;
+  m.ws = _mm512_cmpeq_epi8_mask(c, _mm512_set1_epi8(' ')) |
+         _mm512_cmpeq_epi8_mask(c, _mm512_set1_epi8('\t'));
+  m.slash = _mm512_cmpeq_epi8_mask(c, _mm512_set1_epi8('/'));
+  m.dot = _mm512_cmpeq_epi8_mask(c, _mm512_set1_epi8('.'));
+  m.minus = _mm512_cmpeq_epi8_mask(c, _mm512_set1_epi8('-'));
+  m.digit = _mm512_cmplt_epu8_mask(_mm512_sub_epi8(c, _mm512_set1_epi8('0')),
+                                   _mm512_set1_epi8(10));
+  m.hash = _mm512_cmpeq_epi8_mask(c, _mm512_set1_epi8('#'));
+  return m;
+}
 
-      backlog.push(b);
-      if (backlog.size() >= 8) {
-        backlog.drain_to(queue);
-      }
-    }
+inline token_kernel selectTokenKernel() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512bw")) {
+    return tokenMasksAvx512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return tokenMasksAvx2;
+  }
+  return nullptr;
+}
+static const token_kernel g_token_kernel = selectTokenKernel();
 
-    if (backlog.full()) {
-      _mm_pause();
-    }
+inline uint64_t maskBelow(unsigned n) {
+  return n >= 64 ? ~0ULL : (1ULL << n) - 1;
+}
+
+// The rest of a line after its keyword, classified in one kernel pass with
+// any comment and surrounding whitespace cut off. Masks are shifted so bit
+// 0 is p[0] and are clear from len on.
+struct token_window {
+  const char *p;
+  unsigned len;
+  token_masks m;
+};
+
+// Fills w from [p, e), the normalizeLine equivalent for the SIMD parsers.
+// Returns false if the line does not fit the window or the window plus
+// the 8-byte SWAR overread would pass limit.
+inline bool loadWindow(const char *p, const char *e, const char *limit,
+                       token_window &w) {
+  if (!g_token_kernel || e - p > 64 || limit - p < 72) {
+    return false;
   }
 
-  for (std::size_t i = 0; i < config.num_consumers; ++i) {
-    while (!queue.try_push(const_cast<batch *>(batch_sentinel))) {
-      _mm_pause();
-    }
+  token_masks m = g_token_kernel(p);
+  uint64_t in = maskBelow(static_cast<unsigned>(e - p));
+  if (const uint64_t hash = m.hash & in) {
+    in &= maskBelow(static_cast<unsigned>(__builtin_ctzll(hash)));
+  }
+  const uint64_t text = ~m.ws & in;
+  if (!text) {
+    w = token_window{p, 0, token_masks{}};
+    return true;
   }
+
+  const unsigned b = static_cast<unsigned>(__builtin_ctzll(text));
+  const unsigned len = static_cast<unsigned>(64 - __builtin_clzll(text)) - b;
+  const uint64_t keep = maskBelow(len);
+  m.ws = (m.ws >> b) & keep;
+  m.slash = (m.slash >> b) & keep;
+  m.dot = (m.dot >> b) & keep;
+  m.minus = (m.minus >> b) & keep;
+  m.digit = (m.digit >> b) & keep;
+  m.hash = 0;
+  w = token_window{p + b, len, m};
+  return true;
 }
 
-// ==============================
-// consumer
-// ==============================
-void consumerWork(SPMCQueue<batch *> &queue, consumer_store &store,
-                  std::vector<batch_artifact> &artifacts,
-                  std::size_t consumer_id) {
-  batch *b{};
-  for (;;) {
-    uint64_t _t0 = rdtsc();
-    if (!queue.try_pop(b)) {
-      _mm_pause();
-      continue;
-    }
-    g_perf.wait_cycles += (rdtsc() - _t0);
+// Converts n (1..8) ASCII digits at p with SWAR multiply-adds. Reads 8
+// bytes; the ones past the digits are shifted out.
+inline uint32_t parseDigitsSwar(const char *p, std::size_t n) {
+  uint64_t x;
+  std::memcpy(&x, p, 8);
+  const unsigned sh = static_cast<unsigned>(8 * (8 - n));
+  if (sh) {
+    x = (x << sh) | (0x3030303030303030ULL >> (64 - sh));
+  }
+  x -= 0x3030303030303030ULL;
+  x = (x * 10) + (x >> 8);
+  x = (((x & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+       (((x >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >>
+      32;
+  return static_cast<uint32_t>(x);
+}
 
-    if (b == batch_sentinel) {
-      break;
+// Parses the field [a, b) of a face line as an optionally negative index.
+// An empty field yields 0, which resolves to the sentinel like a missing
+// one does in parseFace.
+inline bool parseFaceField(const char *p, unsigned a, unsigned b,
+                           uint64_t minus, long &out) {
+  if (a == b) {
+    out = 0;
+    return true;
+  }
+  const bool neg = (minus >> a) & 1;
+  a += neg;
+  if (b - a - 1 >= 8) {
+    return false; // no digits or too many for one SWAR word
+  }
+  const long v = parseDigitsSwar(p + a, b - a);
+  out = neg ? -v : v;
+  return true;
+}
+
+// Vectorized parseFace over a loaded window, with an unrolled path for
+// "a/b/c a/b/c a/b/c" triangles. Returns false without touching store when
+// the line needs the scalar parser.
+template <class Store>
+inline bool parseFaceSimd(const token_window &w, std::size_t v_seen,
+                          std::size_t t_seen, std::size_t n_seen,
+                          bool deferred, Store &store) {
+  const char *p = w.p;
+  unsigned len = w.len;
+  const token_masks &m = w.m;
+  if (len == 0) {
+    return true;
+  }
+  if (p[len - 1] == '\r') {
+    // parseLong stops at a trailing '\r', but a lone "\r" token is a
+    // corner of its own.
+    --len;
+    if (len == 0 || ((m.ws >> (len - 1)) & 1)) {
+      return false;
     }
+  }
 
-    uint64_t parse_start = rdtsc();
-    uint64_t _num_lines = 0;
-
-    const std::size_t v0 = store.vertices.size();
-    const std::size_t t0 = store.textures.size();
-    const std::size_t n0 = store.normals.size();
-    const std::size_t ft0 = store.face_tape.size();
-    const std::size_t fb0 = store.face_bounds.size();
-
-    std::size_t v_seen = b->v_seen, t_seen = b->t_seen, n_seen = b->n_seen;
-
-    const char *data = b->data;
-    const std::size_t size = b->size;
-
-    std::size_t i = 0;
-    while (i < size) {
-      const char *line_end =
-          static_cast<const char *>(std::memchr(data + i, '\n', size - i));
-      std::size_t len = line_end
-                            ? static_cast<std::size_t>(line_end - (data + i))
-                            : (size - i);
-
-      std::string_view line(data + i, len);
-      LineType type = classifyLine(line);
-      if (type != LineType::Unknown && normalizeLine(line)) {
-        if (type == LineType::Vertex) {
-          line.remove_prefix(2);
-          std::size_t pos = 0;
-          std::string_view x = nextToken(line, pos);
-          std::string_view y = nextToken(line, pos);
-          std::string_view z = nextToken(line, pos);
-          if (!x.empty() && !y.empty() && !z.empty()) {
-            const char *p0 = x.data(), *e0 = p0 + x.size();
-            const char *p1 = y.data(), *e1 = p1 + y.size();
-            const char *p2 = z.data(), *e2 = p2 + z.size();
-            store.vertices.push_back(vec3f{
-                parseFloat(p0, e0), parseFloat(p1, e1), parseFloat(p2, e2)});
-          }
-          ++v_seen;
-        } else if (type == LineType::Texture) {
-          line.remove_prefix(3);
-          std::size_t pos = 0;
-          std::string_view u = nextToken(line, pos);
-          std::string_view v = nextToken(line, pos);
-          if (!u.empty()) {
-            const char *p0 = u.data(), *e0 = p0 + u.size();
-            float uf = parseFloat(p0, e0);
-            float vf = 0.0f;
-            if (!v.empty()) {
-              const char *p1 = v.data(), *e1 = p1 + v.size();
-              vf = parseFloat(p1, e1);
-            }
-            store.textures.push_back(vec2f{uf, vf});
-          }
-          ++t_seen;
-        } else if (type == LineType::Normal) {
-          line.remove_prefix(3);
-          std::size_t pos = 0;
-          std::string_view x = nextToken(line, pos);
-          std::string_view y = nextToken(line, pos);
-          std::string_view z = nextToken(line, pos);
-          if (!x.empty() && !y.empty() && !z.empty()) {
-            const char *p0 = x.data(), *e0 = p0 + x.size();
-            const char *p1 = y.data(), *e1 = p1 + y.size();
-            const char *p2 = z.data(), *e2 = p2 + z.size();
-            store.normals.push_back(vec3f{
-                parseFloat(p0, e0), parseFloat(p1, e1), parseFloat(p2, e2)});
-          }
-          ++n_seen;
-        } else if (type == LineType::Face) {
-          line.remove_prefix(2);
-          std::size_t r = line.find_first_not_of(" \t");
-          if (r != std::string_view::npos) {
-            line.remove_prefix(r);
-            parseFace(line, v_seen, t_seen, n_seen, store);
-          }
+  const uint64_t in = maskBelow(len);
+  if (~(m.ws | m.slash | m.minus | m.digit) & in) {
+    return false;
+  }
+  const uint64_t ws = m.ws & in;
+  const uint64_t slash = m.slash & in;
+  const uint64_t minus = m.minus & in;
+  const uint64_t sep = ws | slash;
+
+  // Pure triangle: 3 corners of 3 non-empty positive fields, single spaces.
+  if (!minus && __builtin_popcountll(slash) == 6 &&
+      __builtin_popcountll(ws) == 2 && !(sep & 1) &&
+      !((sep >> (len - 1)) & 1) && !(sep & (sep >> 1))) {
+    unsigned cut[9];
+    uint64_t rest = sep;
+    for (int k = 0; k < 8; ++k) {
+      cut[k] = static_cast<unsigned>(__builtin_ctzll(rest));
+      rest &= rest - 1;
+    }
+    cut[8] = len;
+    if (ws == ((1ULL << cut[2]) | (1ULL << cut[5]))) {
+      uint32_t f[9];
+      unsigned a = 0;
+      bool ok = true;
+      for (int k = 0; k < 9; ++k) {
+        const unsigned n = cut[k] - a;
+        ok &= n <= 8;
+        f[k] = parseDigitsSwar(p + a, n <= 8 ? n : 8);
+        a = cut[k] + 1;
+      }
+      if (ok) {
+        const std::size_t slot = 3 * store.face_tape.size();
+        for (int c = 0; c < 3; ++c) {
+          const std::size_t q = slot + 3 * static_cast<std::size_t>(c);
+          store.face_tape.push_back(vec3i{
+              resolveIndex(f[3 * c + 0], v_seen, deferred, q + 0, store),
+              resolveIndex(f[3 * c + 1], t_seen, deferred, q + 1, store),
+              resolveIndex(f[3 * c + 2], n_seen, deferred, q + 2, store)});
         }
+        store.face_bounds.push_back(3);
+        return true;
       }
+    }
+  }
 
-      i += len + (line_end ? 1 : 0);
+  // A '-' must open a field and be followed by a digit.
+  const uint64_t field_starts = ((sep << 1) | 1) & in;
+  if ((minus & ~field_starts) || ((minus << 1) & sep) ||
+      ((minus >> (len - 1)) & 1)) {
+    return false;
+  }
+
+  long idx[3 * 32];
+  std::size_t count = 0;
+  uint64_t tokens = ~ws & in & ((ws << 1) | 1);
+  while (tokens) {
+    const unsigned a = static_cast<unsigned>(__builtin_ctzll(tokens));
+    tokens &= tokens - 1;
+    const uint64_t after = ws & ~maskBelow(a + 1);
+    const unsigned e =
+        after ? static_cast<unsigned>(__builtin_ctzll(after)) : len;
 
-      _num_lines++;
+    const uint64_t cuts = slash & maskBelow(e) & ~maskBelow(a);
+    const int k = __builtin_popcountll(cuts);
+    if (k > 2) {
+      return false;
+    }
+    const unsigned s1 = k > 0 ? static_cast<unsigned>(__builtin_ctzll(cuts)) : e;
+    const unsigned s2 =
+        k > 1 ? static_cast<unsigned>(__builtin_ctzll(cuts & (cuts - 1))) : e;
+
+    long *c = idx + 3 * count;
+    c[1] = c[2] = 0;
+    if (!parseFaceField(p, a, s1, minus, c[0]) ||
+        (k > 0 && !parseFaceField(p, s1 + 1, s2, minus, c[1])) ||
+        (k > 1 && !parseFaceField(p, s2 + 1, e, minus, c[2]))) {
+      return false;
     }
+    ++count;
+  }
+
+  const std::size_t slot = 3 * store.face_tape.size();
+  for (std::size_t i = 0; i < count; ++i) {
+    const long *c = idx + 3 * i;
+    store.face_tape.push_back(
+        vec3i{resolveIndex(c[0], v_seen, deferred, slot + 3 * i + 0, store),
+              resolveIndex(c[1], t_seen, deferred, slot + 3 * i + 1, store),
+              resolveIndex(c[2], n_seen, deferred, slot + 3 * i + 2, store)});
+  }
+  store.face_bounds.push_back(count);
+  return true;
+}
+
+// Parses the token [a, e) as a fixed-format decimal "[-]d+[.d+]" with at
+// most 8 integer, 8 fraction and 15 total digits. The mantissa is exact and
+// so is 10^k, so one division rounds correctly to double; the float
+// conversion only double-rounds on an exact float midpoint, which is
+// left to fast_float.
+inline bool parseDecimalSwar(const char *p, unsigned a, unsigned e,
+                             uint64_t minus, uint64_t dot, float &out) {
+  const bool neg = (minus >> a) & 1;
+  a += neg;
+  if ((minus & ~maskBelow(a)) || __builtin_popcountll(dot) > 1) {
+    return false;
+  }
+  const unsigned ip_end =
+      dot ? static_cast<unsigned>(__builtin_ctzll(dot)) : e;
+  const unsigned ni = ip_end - a;
+  const unsigned nf = dot ? e - ip_end - 1 : 0;
+  if (ni - 1 >= 8 || (dot && nf - 1 >= 8) || ni + nf > 15) {
+    return false;
+  }
+
+  uint64_t mant = parseDigitsSwar(p + a, ni);
+  double x = static_cast<double>(mant);
+  if (nf) {
+    mant = mant * kPow10[nf] + parseDigitsSwar(p + ip_end + 1, nf);
+    x = static_cast<double>(mant) / static_cast<double>(kPow10[nf]);
+  }
+  if ((std::bit_cast<uint64_t>(x) & 0x1FFFFFFFULL) == 0x10000000ULL) {
+    return false;
+  }
+  const float f = static_cast<float>(x);
+  out = neg ? -f : f;
+  return true;
+}
 
-    g_perf.parse_cycles += (rdtsc() - parse_start);
-    g_perf.bytes_processed += b->size;
-    g_perf.lines_processed += _num_lines;
+// Splits s into whitespace separated tokens like nextToken and parses the
+// first n of them into out. Returns the number of tokens parsed.
+inline std::size_t parseCoordsScalar(std::string_view s, float *out,
+                                     std::size_t n) {
+  std::size_t pos = 0;
+  std::size_t k = 0;
+  for (; k < n; ++k) {
+    std::string_view t = nextToken(s, pos);
+    if (t.empty()) {
+      break;
+    }
+    const char *b = t.data(), *e = b + t.size();
+    out[k] = parseFloat(b, e);
+  }
+  return k;
+}
 
-    batch_artifact a{};
-    a.batch_id = b->batch_id;
-    a.consumer_id = consumer_id;
-    a.v = range{v0, store.vertices.size()};
-    a.t = range{t0, store.textures.size()};
-    a.n = range{n0, store.normals.size()};
-    a.ft = range{ft0, store.face_tape.size()};
-    a.fb = range{fb0, store.face_bounds.size()};
-    artifacts[b->batch_id] = a;
+// parseCoordsScalar over a loaded window. Fixed format decimals take the
+// SWAR path; other tokens go to fast_float.
+inline std::size_t parseCoords(const token_window &w, float *out,
+                               std::size_t n) {
+  const char *p = w.p;
+  const token_masks &m = w.m;
+  const unsigned len = w.len;
+  const uint64_t in = maskBelow(len);
+  const uint64_t ws = m.ws;
+  const uint64_t bad = ~(m.ws | m.dot | m.minus | m.digit) & in;
+  uint64_t tokens = ~ws & in & ((ws << 1) | 1);
+  std::size_t k = 0;
+  for (; tokens && k < n; ++k) {
+    const unsigned a = static_cast<unsigned>(__builtin_ctzll(tokens));
+    tokens &= tokens - 1;
+    const uint64_t after = ws & ~maskBelow(a + 1);
+    const unsigned e =
+        after ? static_cast<unsigned>(__builtin_ctzll(after)) : len;
+    const uint64_t tok = maskBelow(e) & ~maskBelow(a);
+    if ((bad & tok) ||
+        !parseDecimalSwar(p, a, e, m.minus & tok, m.dot & tok, out[k])) {
+      const char *b = p + a, *end = p + e;
+      out[k] = parseFloat(b, end);
+    }
   }
+  return k;
 }
 
 // ==============================
-// Mesh
+// producer
 // ==============================
-class _MeshImpl {
-public:
-  mesh_config mConfig;
-  std::vector<consumer_store> mConsumerStores;
-  std::vector<batch> mBatches;
-  std::vector<batch_artifact> mBatchArtifacts;
-  SPMCQueue<batch *> mQueue;
+void producerWork(SPMCQueue<batch *> &queue, const mesh_config &config,
+                  batch *batches, std::size_t num_batches) {
+  for (std::size_t i = 0; i < num_batches; ++i) {
+    queue.push(&batches[i], config.wait);
+  }
 
-  _MeshImpl(mesh_config config)
-      : mConfig(config), mQueue(config.queue_capacity) {
-    mConsumerStores.resize(config.num_consumers);
+  for (std::size_t i = 0; i < config.num_consumers; ++i) {
+    queue.push(const_cast<batch *>(batch_sentinel), config.wait);
   }
+}
 
-  bool importObj(void *obj, std::size_t file_size) {
-    const std::size_t num_consumers = mConfig.num_consumers;
-    std::vector<std::thread> consumers;
-    consumers.reserve(num_consumers);
+// Chops the mapping [data, data + size) into batches only as the window
+// allows. Pages behind the oldest batch still being parsed are dropped,
+// and the batch after the one just queued is prefetched. batches must have
+// room for every batch so pushing never moves them.
+void streamProducerWork(SPMCQueue<batch *> &queue, const mesh_config &config,
+                        const char *data, std::size_t size,
+                        std::vector<batch> &batches, stream_state &stream) {
+  const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  char *base = const_cast<char *>(data);
+  std::size_t off = 0, released = 0, oldest = 0;
 
-    for (std::size_t i = 0; i < num_consumers; ++i) {
-      auto start_alloc = std::chrono::high_resolution_clock::now();
-      mConsumerStores[i].vertices.reserve(file_size / (num_consumers * 48));
-      mConsumerStores[i].textures.reserve(file_size / (num_consumers * 80));
-      mConsumerStores[i].normals.reserve(file_size / (num_consumers * 48));
-      mConsumerStores[i].face_tape.reserve(file_size / (num_consumers * 64));
-      mConsumerStores[i].face_bounds.reserve(file_size / (num_consumers * 48));
-      auto end_alloc = std::chrono::high_resolution_clock::now();
-      g_perf.alloc_time_ns +=
-          std::chrono::duration_cast<std::chrono::nanoseconds>(end_alloc -
-                                                               start_alloc)
-              .count();
-      consumers.emplace_back([this, obj, i]() {
-        consumerWork(mQueue, mConsumerStores[i], mBatchArtifacts, i);
-      });
+  auto release = [&]() {
+    while (oldest < batches.size() &&
+           stream.done[oldest].load(std::memory_order_acquire)) {
+      ++oldest;
+    }
+    const std::size_t frontier =
+        oldest < batches.size()
+            ? static_cast<std::size_t>(batches[oldest].data - data)
+            : off;
+    const std::size_t cut = frontier / page * page;
+    if (cut > released) {
+      madvise(base + released, cut - released, MADV_DONTNEED);
+      released = cut;
     }
+  };
 
-    std::thread producer([this, obj, file_size]() {
-      producerWork(mQueue, obj, file_size, mConfig, mBatches.data());
-    });
+  while (off < size) {
+    for (;;) {
+      const std::size_t seen =
+          stream.completed.load(std::memory_order_acquire);
+      release();
+      if (oldest == batches.size() ||
+          off + config.batch_size - released <= config.stream_window) {
+        break;
+      }
+      stream.completed.wait(seen, std::memory_order_acquire);
+    }
 
-    producer.join();
-    for (auto &t : consumers) {
-      t.join();
+    const range r = build_range(data, size, off, config.batch_size);
+    if (off < size) {
+      const std::size_t ahead = off / page * page;
+      madvise(base + ahead,
+              std::min(config.batch_size + (off - ahead), size - ahead),
+              MADV_WILLNEED);
     }
-    return true;
+    batches.push_back(batch{data + r.begin, r.end - r.begin, batches.size(),
+                            0, 0, 0, true});
+    queue.push(&batches.back(), config.wait);
   }
 
-  bool exportObj(int fd) {
-    std::string out;
-    out.reserve(1 << 20);
+  for (std::size_t i = 0; i < config.num_consumers; ++i) {
+    queue.push(const_cast<batch *>(batch_sentinel), config.wait);
+  }
+}
 
-    auto flushIf = [&]() -> bool {
-      return (out.size() < (1 << 20)) ? true : flushFd(fd, out);
-    };
+// ==============================
+// batch parser
+// ==============================
+// Parses one batch, appending its geometry to store (a consumer_store or
+// a slice_store).
+template <class Store>
+batch_artifact parseBatch(const batch &b, Store &store,
+                          std::size_t consumer_id, PerfMetrics &perf) {
+  uint64_t parse_start = rdtsc();
+  uint64_t _num_lines = 0;
 
-    auto emitV = [&](const vec3f &v) -> bool {
-      out += "v ";
-      appendF32(out, v.x);
-      out += " ";
-      appendF32(out, v.y);
-      out += " ";
-      appendF32(out, v.z);
-      out += "\n";
-      return flushIf();
-    };
-    auto emitVT = [&](const vec2f &t) -> bool {
-      out += "vt ";
-      appendF32(out, t.u);
-      out += " ";
-      appendF32(out, t.v);
-      out += "\n";
-      return flushIf();
-    };
-    auto emitVN = [&](const vec3f &n) -> bool {
-      out += "vn ";
-      appendF32(out, n.x);
-      out += " ";
-      appendF32(out, n.y);
-      out += " ";
-      appendF32(out, n.z);
-      out += "\n";
-      return flushIf();
-    };
+  const std::size_t v0 = store.vertices.size();
+  const std::size_t t0 = store.textures.size();
+  const std::size_t n0 = store.normals.size();
+  const std::size_t ft0 = store.face_tape.size();
+  const std::size_t fb0 = store.face_bounds.size();
+  const std::size_t fx0 = store.fixups.size();
 
-    auto emitIndex = [&](idx_t x) {
-      appendU64(out, static_cast<std::size_t>(x) + 1);
+  // Deferred batches count from zero, see resolveDeferred.
+  std::size_t v_seen = b.deferred ? 0 : b.v_seen;
+  std::size_t t_seen = b.deferred ? 0 : b.t_seen;
+  std::size_t n_seen = b.deferred ? 0 : b.n_seen;
+  const std::size_t v_base = v_seen, t_base = t_seen, n_base = n_seen;
+
+  const char *data = b.data;
+  const std::size_t size = b.size;
+
+  std::size_t i = 0;
+  while (i < size) {
+    const char *line_end =
+        static_cast<const char *>(std::memchr(data + i, '\n', size - i));
+    std::size_t len = line_end
+                          ? static_cast<std::size_t>(line_end - (data + i))
+                          : (size - i);
+
+    const char *p = data + i;
+    const char *e = p + len;
+    const LineType type = classifyLine(p, e);
+    if (type != LineType::Unknown) {
+      // Lines that fit a SIMD window are trimmed from its masks; others
+      // go through normalizeLine and the scalar parsers.
+      token_window w;
+      const bool simd = loadWindow(p, e, data + size, w);
+      std::string_view rest;
+      if (!simd) {
+        rest = std::string_view(p, static_cast<std::size_t>(e - p));
+        if (!normalizeLine(rest)) {
+          rest = {};
+        }
+      }
+
+      if (type == LineType::Vertex) {
+        float c[3];
+        if ((simd ? parseCoords(w, c, 3) : parseCoordsScalar(rest, c, 3)) ==
+            3) {
+          store.vertices.push_back(vec3f{c[0], c[1], c[2]});
+        }
+        ++v_seen;
+      } else if (type == LineType::Texture) {
+        float c[2] = {0.0f, 0.0f};
+        if ((simd ? parseCoords(w, c, 2) : parseCoordsScalar(rest, c, 2)) >
+            0) {
+          store.textures.push_back(vec2f{c[0], c[1]});
+        }
+        ++t_seen;
+      } else if (type == LineType::Normal) {
+        float c[3];
+        if ((simd ? parseCoords(w, c, 3) : parseCoordsScalar(rest, c, 3)) ==
+            3) {
+          store.normals.push_back(vec3f{c[0], c[1], c[2]});
+        }
+        ++n_seen;
+      } else if (!simd ||
+                 !parseFaceSimd(w, v_seen, t_seen, n_seen, b.deferred, store)) {
+        if (simd) {
+          rest = std::string_view(w.p, w.len);
+        }
+        parseFace(rest, v_seen, t_seen, n_seen, b.deferred, store);
+      }
+    }
+
+    i += len + (line_end ? 1 : 0);
+
+    _num_lines++;
+  }
+
+  perf.parse_cycles += (rdtsc() - parse_start);
+  perf.bytes_processed += b.size;
+  perf.lines_processed += _num_lines;
+
+  batch_artifact a{};
+  a.batch_id = b.batch_id;
+  a.consumer_id = consumer_id;
+  a.v = range{v0, store.vertices.size()};
+  a.t = range{t0, store.textures.size()};
+  a.n = range{n0, store.normals.size()};
+  a.ft = range{ft0, store.face_tape.size()};
+  a.fb = range{fb0, store.face_bounds.size()};
+  a.fx = range{fx0, store.fixups.size()};
+  a.lines = line_counts{v_seen - v_base, t_seen - t_base, n_seen - n_base};
+  return a;
+}
+
+// ==============================
+// consumer
+// ==============================
+// Parses queued batches until a sentinel, handing each batch and its
+// artifact to emit.
+template <class Emit>
+void consumerWork(SPMCQueue<batch *> &queue, consumer_store &store,
+                  std::size_t consumer_id, const spmc_wait_policy &wait,
+                  PerfMetrics &perf, Emit &&emit) {
+  batch *b{};
+  for (;;) {
+    uint64_t _t0 = rdtsc();
+    const bool ok = queue.pop(b, wait);
+    perf.wait_cycles += (rdtsc() - _t0);
+
+    if (!ok || b == batch_sentinel) {
+      break;
+    }
+
+    emit(*b, parseBatch(*b, store, consumer_id, perf));
+  }
+}
+
+// ==============================
+// read ring
+// ==============================
+// Slot buffers that a Source fills with consecutive pieces of the OBJ text.
+// Each slot is a carry area, for the partial line the previous piece ended
+// on, followed by the piece; it is refilled once every batch cut from it
+// has been parsed.
+struct slot_ring {
+  std::size_t num_slots;
+  std::size_t slot_size;  // piece bytes, a multiple of the page size
+  std::size_t carry_size; // longest line that may straddle two pieces
+  std::size_t stride;
+  std::unique_ptr<char, decltype(&std::free)> arena;
+  std::unique_ptr<std::atomic<std::size_t>[]> refs;
+  std::atomic<std::size_t> freed{0};
+
+  slot_ring(std::size_t n, std::size_t slot)
+      : num_slots(n), slot_size(slot), carry_size(slot / 4),
+        stride(slot + slot / 4),
+        arena(static_cast<char *>(std::aligned_alloc(4096, n * stride)),
+              &std::free),
+        refs(std::make_unique<std::atomic<std::size_t>[]>(n)) {}
+
+  char *base() const { return arena.get(); }
+  std::size_t bytes() const { return num_slots * stride; }
+  char *piece(std::size_t s) const {
+    return arena.get() + s * stride + carry_size;
+  }
+  std::size_t slotOf(const char *p) const {
+    return static_cast<std::size_t>(p - arena.get()) / stride;
+  }
+
+  void release(std::size_t s) {
+    if (refs[s].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      freed.fetch_add(1, std::memory_order_release);
+      freed.notify_one();
+    }
+  }
+};
+
+// Size of an input only known once it has been read to the end, such as a
+// pipe.
+static constexpr std::size_t kUnknownSize =
+    std::numeric_limits<std::size_t>::max();
+
+// O_DIRECT transfers must start and end on this boundary, which every ring
+// piece does.
+static constexpr std::size_t kDirectAlign = 4096;
+
+inline bool isDirectFd(int fd) {
+  const int flags = fcntl(fd, F_GETFL);
+  return flags != -1 && (flags & O_DIRECT) != 0;
+}
+
+// Reads up to len bytes at off, or from the current position if off is
+// kUnknownSize, retrying short reads. Returns the bytes read, short only at
+// end of file, or -1. On a direct fd, off and len must be kDirectAlign
+// multiples; a read that ends off that boundary can only have hit the end
+// of the file, so it is not retried at an unaligned offset.
+inline std::ptrdiff_t readFull(int fd, char *dst, std::size_t len,
+                               std::size_t off, bool direct = false) {
+  std::size_t got = 0;
+  while (got < len && !(direct && got % kDirectAlign != 0)) {
+    const ssize_t r =
+        off == kUnknownSize
+            ? read(fd, dst + got, len - got)
+            : pread(fd, dst + got, len - got, static_cast<off_t>(off + got));
+    if (r < 0 && errno == EINTR) {
+      continue;
+    }
+    if (r < 0) {
+      return -1;
+    }
+    if (r == 0) {
+      break;
+    }
+    got += static_cast<std::size_t>(r);
+  }
+  return static_cast<std::ptrdiff_t>(got);
+}
+
+// A Source fills ring pieces in the background:
+//   submit(piece, dst)  starts filling piece (slot_size bytes of the text
+//                       at piece * slot_size) into dst;
+//   wait(piece)         blocks until it is filled and returns its size,
+//                       which is below slot_size only at the end, or -1.
+// At most num_slots pieces are outstanding, and each is waited on once.
+// It also asks for workers() pool threads, which run work() until stop()
+// is called once the producer is done with it.
+
+// Runs fill(piece, dst) for submitted pieces on num_workers pool threads.
+// fill returns the piece size or -1; with a single worker, pieces are
+// filled in submission order.
+template <class Fill> class threaded_source {
+public:
+  threaded_source(Fill fill, const slot_ring &ring, std::size_t num_workers)
+      : mFill(std::move(fill)), mResults(ring.num_slots, kPending),
+        mWorkers(num_workers) {}
+
+  threaded_source(const threaded_source &) = delete;
+  threaded_source &operator=(const threaded_source &) = delete;
+
+  void submit(std::size_t piece, char *dst) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mResults[piece % mResults.size()] = kPending;
+    mRequests.push_back(request{piece, dst});
+    mWake.notify_one();
+  }
+
+  std::ptrdiff_t wait(std::size_t piece) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    std::ptrdiff_t &r = mResults[piece % mResults.size()];
+    mDone.wait(lock, [&r]() { return r != kPending; });
+    return r;
+  }
+
+  std::size_t workers() const { return mWorkers; }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mStop = true;
+    }
+    mWake.notify_all();
+  }
+
+  // Fills queued pieces until stop() is called and the queue is empty.
+  void work() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (;;) {
+      mWake.wait(lock, [this]() { return mStop || !mRequests.empty(); });
+      if (mRequests.empty()) {
+        return; // stopping
+      }
+      const request req = mRequests.front();
+      mRequests.pop_front();
+      lock.unlock();
+
+      const std::ptrdiff_t r = mFill(req.piece, req.dst);
+
+      lock.lock();
+      mResults[req.piece % mResults.size()] = r;
+      mDone.notify_all();
+    }
+  }
+
+private:
+  static constexpr std::ptrdiff_t kPending =
+      std::numeric_limits<std::ptrdiff_t>::min();
+
+  struct request {
+    std::size_t piece;
+    char *dst;
+  };
+
+  Fill mFill;
+  std::vector<std::ptrdiff_t> mResults; // by slot
+  std::size_t mWorkers;
+  std::mutex mMutex;
+  std::condition_variable mWake;
+  std::condition_variable mDone;
+  std::deque<request> mRequests;
+  bool mStop = false;
+};
+
+// Fills pieces with preads of a regular file; the fallback when io_uring
+// is unavailable. A file of kUnknownSize is read sequentially instead,
+// which needs a single worker. Every read asks for a whole slot, so the
+// lengths stay aligned for O_DIRECT; the last piece simply comes back
+// short.
+struct pread_fill {
+  int fd;
+  std::size_t file_size;
+  std::size_t slot_size;
+  bool direct;
+
+  std::ptrdiff_t operator()(std::size_t piece, char *dst) const {
+    if (file_size == kUnknownSize) {
+      return readFull(fd, dst, slot_size, kUnknownSize, direct);
+    }
+    const std::size_t off = piece * slot_size;
+    if (off >= file_size) {
+      return 0;
+    }
+    const std::ptrdiff_t r = readFull(fd, dst, slot_size, off, direct);
+    return r < 0 ? r
+                 : std::min<std::ptrdiff_t>(
+                       r, static_cast<std::ptrdiff_t>(file_size - off));
+  }
+};
+using pread_source = threaded_source<pread_fill>;
+
+// Compressed inputs are recognized by their magic bytes; plain OBJ text
+// never starts with either.
+enum class compression { None, Gzip, Zstd };
+
+inline compression detectCompression(const char *data, std::size_t size) {
+  if (size >= 2 && static_cast<unsigned char>(data[0]) == 0x1f &&
+      static_cast<unsigned char>(data[1]) == 0x8b) {
+    return compression::Gzip;
+  }
+  if (size >= 4) {
+    uint32_t magic;
+    std::memcpy(&magic, data, 4);
+    if (magic == 0xFD2FB528U || (magic & 0xFFFFFFF0U) == 0x184D2A50U) {
+      return compression::Zstd;
+    }
+  }
+  return compression::None;
+}
+
+#ifdef MESH_HAVE_ZLIB
+// Inflates gzip members (or a zlib stream) from memory into consecutive
+// pieces. Stateful, so it must run on a single worker.
+class gzip_fill {
+public:
+  gzip_fill(const char *data, std::size_t size, std::size_t slot_size)
+      : mNext(data), mEnd(data + size), mSlotSize(slot_size),
+        mStream(new z_stream{}, [](z_stream *z) {
+          inflateEnd(z);
+          delete z;
+        }) {
+    mOk = inflateInit2(mStream.get(), 15 + 32) == Z_OK; // gzip or zlib
+  }
+
+  std::ptrdiff_t operator()(std::size_t, char *dst) {
+    if (!mOk) {
+      return -1;
+    }
+    z_stream &z = *mStream;
+    z.next_out = reinterpret_cast<Bytef *>(dst);
+    z.avail_out = static_cast<uInt>(mSlotSize);
+    while (!mEnded && z.avail_out > 0) {
+      if (z.avail_in == 0) {
+        if (mNext == mEnd) {
+          mOk = false; // truncated
+          return -1;
+        }
+        const std::size_t n = std::min<std::size_t>(mEnd - mNext, 1u << 30);
+        z.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(mNext));
+        z.avail_in = static_cast<uInt>(n);
+        mNext += n;
+      }
+
+      const int rc = inflate(&z, Z_NO_FLUSH);
+      if (rc == Z_STREAM_END) {
+        // Another member may follow; anything else is trailing padding.
+        const char *rest = reinterpret_cast<const char *>(z.next_in);
+        const std::size_t left = z.avail_in;
+        if (left == 0 && mNext < mEnd) {
+          rest = mNext;
+        }
+        if (detectCompression(rest, (left ? left : mEnd - mNext)) ==
+            compression::Gzip) {
+          inflateReset(&z);
+        } else {
+          mEnded = true;
+        }
+      } else if (rc != Z_OK) {
+        mOk = false;
+        return -1;
+      }
+    }
+    return static_cast<std::ptrdiff_t>(mSlotSize - z.avail_out);
+  }
+
+private:
+  const char *mNext; // input not yet handed to zlib
+  const char *mEnd;
+  std::size_t mSlotSize;
+  std::unique_ptr<z_stream, void (*)(z_stream *)> mStream;
+  bool mOk = false;
+  bool mEnded = false;
+};
+#endif
+
+#ifdef MESH_HAVE_ZSTD
+// A zstd frame and the range of the decompressed text it holds.
+struct zstd_frame {
+  const char *src;
+  std::size_t csize;
+  std::size_t begin, end;
+};
+
+// Hops over the frames of [data, data + size), skipping skippable frames
+// such as seek tables. Fails unless every frame records its content size.
+inline bool indexZstdFrames(const char *data, std::size_t size,
+                            std::vector<zstd_frame> &frames) {
+  std::size_t off = 0, out = 0;
+  while (off < size) {
+    const std::size_t cs = ZSTD_findFrameCompressedSize(data + off, size - off);
+    if (ZSTD_isError(cs)) {
+      return false;
+    }
+    uint32_t magic = 0;
+    std::memcpy(&magic, data + off, std::min<std::size_t>(4, size - off));
+    if ((magic & 0xFFFFFFF0U) != 0x184D2A50U) {
+      const unsigned long long ds =
+          ZSTD_getFrameContentSize(data + off, size - off);
+      if (ds == ZSTD_CONTENTSIZE_UNKNOWN || ds == ZSTD_CONTENTSIZE_ERROR) {
+        return false;
+      }
+      frames.push_back(zstd_frame{data + off, cs, out, out + ds});
+      out += ds;
+    }
+    off += cs;
+  }
+  return true;
+}
+
+// Fills any piece independently from indexed frames, so pieces decompress
+// in parallel. A frame straddling a piece boundary is decompressed into
+// scratch by each piece it touches, so frames should not exceed a piece.
+struct zstd_frame_fill {
+  const std::vector<zstd_frame> *frames;
+  std::size_t slot_size;
+
+  std::ptrdiff_t operator()(std::size_t piece, char *dst) const {
+    static thread_local std::unique_ptr<ZSTD_DCtx, std::size_t (*)(ZSTD_DCtx *)>
+        dctx(ZSTD_createDCtx(), &ZSTD_freeDCtx);
+    static thread_local buffer<char> scratch;
+
+    const std::size_t total = frames->empty() ? 0 : frames->back().end;
+    const std::size_t lo = piece * slot_size;
+    if (lo >= total) {
+      return 0;
+    }
+    const std::size_t hi = std::min(lo + slot_size, total);
+
+    auto f = std::upper_bound(
+        frames->begin(), frames->end(), lo,
+        [](std::size_t x, const zstd_frame &fr) { return x < fr.end; });
+    for (; f != frames->end() && f->begin < hi; ++f) {
+      const std::size_t ds = f->end - f->begin;
+      if (f->begin >= lo && f->end <= hi) {
+        if (ZSTD_decompressDCtx(dctx.get(), dst + (f->begin - lo), ds, f->src,
+                                f->csize) != ds) {
+          return -1;
+        }
+        continue;
+      }
+      scratch.resize(ds);
+      if (ZSTD_decompressDCtx(dctx.get(), scratch.data(), ds, f->src,
+                              f->csize) != ds) {
+        return -1;
+      }
+      const std::size_t a = std::max(lo, f->begin), b = std::min(hi, f->end);
+      std::memcpy(dst + (a - lo), scratch.data() + (a - f->begin), b - a);
+    }
+    return static_cast<std::ptrdiff_t>(hi - lo);
+  }
+};
+
+// Streams any zstd input, including frames without a content size, into
+// consecutive pieces. Stateful, so it must run on a single worker.
+class zstd_stream_fill {
+public:
+  zstd_stream_fill(const char *data, std::size_t size, std::size_t slot_size)
+      : mIn{data, size, 0}, mSlotSize(slot_size),
+        mStream(ZSTD_createDStream(), &ZSTD_freeDStream) {}
+
+  std::ptrdiff_t operator()(std::size_t, char *dst) {
+    ZSTD_outBuffer out{dst, mSlotSize, 0};
+    while (out.pos < out.size && mIn.pos < mIn.size) {
+      const std::size_t rc = ZSTD_decompressStream(mStream.get(), &out, &mIn);
+      if (ZSTD_isError(rc)) {
+        return -1;
+      }
+      mLast = rc;
+    }
+    if (out.pos < out.size && mLast != 0) {
+      return -1; // truncated frame
+    }
+    return static_cast<std::ptrdiff_t>(out.pos);
+  }
+
+private:
+  ZSTD_inBuffer mIn;
+  std::size_t mSlotSize;
+  std::unique_ptr<ZSTD_DStream, std::size_t (*)(ZSTD_DStream *)> mStream;
+  std::size_t mLast = 0; // 0 once the current frame is complete
+};
+#endif
+
+#ifdef MESH_HAVE_LIBURING
+// Regular file reads through io_uring into the ring's arena, registered as
+// one fixed buffer when the memlock limit allows. Completions arrive in any
+// order and are parked by slot until waited on.
+class uring_source {
+public:
+  uring_source(int fd, std::size_t file_size, const slot_ring &ring)
+      : mFd(fd), mFileSize(file_size), mSlotSize(ring.slot_size),
+        mDirect(isDirectFd(fd)), mResults(ring.num_slots, kPending),
+        mDst(ring.num_slots) {
+    const unsigned depth =
+        static_cast<unsigned>(spmc_next_pow2(ring.num_slots));
+    mOk = io_uring_queue_init(depth, &mRing, 0) == 0;
+    if (mOk) {
+      iovec iov{ring.base(), ring.bytes()};
+      mFixed = io_uring_register_buffers(&mRing, &iov, 1) == 0;
+    }
+  }
+
+  ~uring_source() {
+    if (mOk) {
+      io_uring_queue_exit(&mRing);
+    }
+  }
+
+  uring_source(const uring_source &) = delete;
+  uring_source &operator=(const uring_source &) = delete;
+
+  bool ok() const { return mOk; }
+
+  void submit(std::size_t piece, char *dst) {
+    const std::size_t s = piece % mResults.size();
+    const std::size_t off = piece * mSlotSize;
+    mDst[s] = dst;
+    if (off >= mFileSize) {
+      mResults[s] = 0;
+      return;
+    }
+    mResults[s] = kPending;
+    // A whole slot, so the length stays aligned for O_DIRECT.
+    const unsigned len = static_cast<unsigned>(mSlotSize);
+    io_uring_sqe *sqe = io_uring_get_sqe(&mRing);
+    if (mFixed) {
+      io_uring_prep_read_fixed(sqe, mFd, dst, len, off, 0);
+    } else {
+      io_uring_prep_read(sqe, mFd, dst, len, off);
+    }
+    io_uring_sqe_set_data(sqe, reinterpret_cast<void *>(piece));
+    io_uring_submit(&mRing);
+  }
+
+  std::ptrdiff_t wait(std::size_t piece) {
+    const std::size_t s = piece % mResults.size();
+    while (mResults[s] == kPending) {
+      io_uring_cqe *cqe;
+      int rc;
+      while ((rc = io_uring_wait_cqe(&mRing, &cqe)) == -EINTR) {
+      }
+      if (rc < 0) {
+        return -1;
+      }
+      const auto done =
+          reinterpret_cast<std::uintptr_t>(io_uring_cqe_get_data(cqe));
+      mResults[done % mResults.size()] = cqe->res;
+      io_uring_cqe_seen(&mRing, cqe);
+    }
+
+    // Buffered reads may come back short before the end of the file.
+    std::ptrdiff_t got = mResults[s];
+    const std::size_t off = piece * mSlotSize;
+    if (got >= 0 && off < mFileSize) {
+      const std::size_t want = std::min(mSlotSize, mFileSize - off);
+      const std::size_t have = static_cast<std::size_t>(got);
+      if (have < want && !(mDirect && have % kDirectAlign != 0)) {
+        const std::ptrdiff_t r = readFull(mFd, mDst[s] + have,
+                                          mSlotSize - have, off + have, mDirect);
+        got = r < 0 ? -1 : got + r;
+      }
+      got = std::min<std::ptrdiff_t>(got, static_cast<std::ptrdiff_t>(want));
+    }
+    return got;
+  }
+
+  // The kernel does the reading, so no pool threads are needed.
+  std::size_t workers() const { return 0; }
+  void work() {}
+  void stop() {}
+
+private:
+  static constexpr std::ptrdiff_t kPending =
+      std::numeric_limits<std::ptrdiff_t>::min();
+
+  int mFd;
+  std::size_t mFileSize;
+  std::size_t mSlotSize;
+  bool mDirect; // fd was opened with O_DIRECT
+  std::vector<std::ptrdiff_t> mResults; // by slot
+  std::vector<char *> mDst;             // by slot
+  io_uring mRing{};
+  bool mOk = false;
+  bool mFixed = false;
+};
+#endif
+
+// Feeds the consumers from a Source: keeps a fill in flight for every free
+// slot, prepends each piece with the previous piece's partial last line and
+// queues the batches cut from it. Returns false on a read error or a line
+// longer than the carry area.
+template <class Source>
+bool ringProducerWork(SPMCQueue<batch *> &queue, const mesh_config &config,
+                      Source &src, slot_ring &ring,
+                      std::deque<batch> &batches) {
+  const std::size_t n = ring.num_slots;
+  buffer<char> carry(ring.carry_size);
+  std::size_t carry_len = 0;
+  std::size_t submitted = 0;
+  std::size_t k = 0;
+  bool ok = true;
+
+  for (;; ++k) {
+    const std::size_t s = k % n;
+    for (;;) {
+      const std::size_t seen = ring.freed.load(std::memory_order_acquire);
+      while (submitted < k + n &&
+             ring.refs[submitted % n].load(std::memory_order_acquire) == 0) {
+        src.submit(submitted, ring.piece(submitted % n));
+        ++submitted;
+      }
+      if (submitted > k) {
+        break;
+      }
+      ring.freed.wait(seen, std::memory_order_acquire);
+    }
+
+    const std::ptrdiff_t got = src.wait(k);
+    if (got < 0) {
+      ok = false;
+      break;
+    }
+    char *begin = ring.piece(s) - carry_len;
+    char *end = ring.piece(s) + got;
+    std::memcpy(begin, carry.data(), carry_len);
+    const bool last = static_cast<std::size_t>(got) < ring.slot_size;
+
+    carry_len = 0;
+    if (!last) {
+      const char *nl = static_cast<const char *>(
+          memrchr(begin, '\n', static_cast<std::size_t>(end - begin)));
+      const std::size_t tail =
+          static_cast<std::size_t>(end - (nl ? nl + 1 : begin));
+      if (tail > ring.carry_size) {
+        ok = false;
+        break;
+      }
+      std::memcpy(carry.data(), end - tail, tail);
+      carry_len = tail;
+      end -= tail;
+    }
+
+    // The producer holds the slot until every batch in it is queued.
+    ring.refs[s].store(1, std::memory_order_relaxed);
+    const std::size_t size = static_cast<std::size_t>(end - begin);
+    std::size_t off = 0;
+    while (off < size) {
+      const range r = build_range(begin, size, off, config.batch_size);
+      ring.refs[s].fetch_add(1, std::memory_order_relaxed);
+      batches.push_back(batch{begin + r.begin, r.end - r.begin,
+                              batches.size(), 0, 0, 0, true});
+      queue.push(&batches.back(), config.wait);
+    }
+    ring.release(s);
+
+    if (last) {
+      break;
+    }
+  }
+
+  // Let fills still in flight land before the ring goes away.
+  for (std::size_t i = k + 1; i < submitted; ++i) {
+    src.wait(i);
+  }
+  for (std::size_t i = 0; i < config.num_consumers; ++i) {
+    queue.push(const_cast<batch *>(batch_sentinel), config.wait);
+  }
+  return ok;
+}
+
+// ==============================
+// obj export
+// ==============================
+// An OBJ file is four runs over the chunks: positions, texcoords, normals,
+// then faces. Each (run, chunk) pair is a job that formats into blocks of
+// its own, so jobs can be formatted on any thread while a writer hands the
+// finished ones to writev in file order.
+enum class obj_run { Positions, Texcoords, Normals, Faces };
+static constexpr std::size_t kObjRuns = 4;
+
+// Formatted text is staged in page-aligned blocks of this size.
+static constexpr std::size_t kExportBlock = 256 * 1024;
+// Room asked for per vertex line or face corner.
+static constexpr std::size_t kMaxObjElement = 4 * kMaxFloatChars;
+
+// Free list of export blocks, so blocks written out are formatted into
+// again instead of being reallocated.
+class block_pool {
+public:
+  block_pool() = default;
+  block_pool(const block_pool &) = delete;
+  block_pool &operator=(const block_pool &) = delete;
+  ~block_pool() {
+    for (char *b : mFree) {
+      std::free(b);
+    }
+  }
+
+  char *acquire() {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      if (!mFree.empty()) {
+        char *b = mFree.back();
+        mFree.pop_back();
+        return b;
+      }
+    }
+    void *b = std::aligned_alloc(4096, kExportBlock);
+    if (!b) {
+      throw std::bad_alloc();
+    }
+    return static_cast<char *>(b);
+  }
+
+  void release(char *b) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mFree.push_back(b);
+  }
+
+private:
+  std::mutex mMutex;
+  std::vector<char *> mFree;
+};
+
+// Formats into blocks from a block_pool and records each filled block as
+// an iovec starting at the block. room(n) returns a cursor with n free
+// bytes, moving to a new block when the current one is short; the tail
+// left behind is simply not written. commit() takes the advanced cursor.
+class block_sink {
+public:
+  block_sink(block_pool &pool, std::vector<iovec> &iov)
+      : mPool(pool), mIov(iov) {}
+
+  char *room(std::size_t n) {
+    if (static_cast<std::size_t>(mEnd - mCur) < n) {
+      finish();
+      mBlock = mCur = mPool.acquire();
+      mEnd = mBlock + kExportBlock;
+    }
+    return mCur;
+  }
+  void commit(char *cur) { mCur = cur; }
+
+  // Copies raw bytes in, spanning blocks as needed.
+  void append(const void *data, std::size_t n) {
+    const char *p = static_cast<const char *>(data);
+    while (n) {
+      char *dst = room(1);
+      const std::size_t step =
+          std::min(n, static_cast<std::size_t>(mEnd - dst));
+      std::memcpy(dst, p, step);
+      mCur = dst + step;
+      p += step;
+      n -= step;
+    }
+  }
+
+  // Records the current block, or returns it to the pool if it is empty.
+  void finish() {
+    if (mCur != mBlock) {
+      mIov.push_back({mBlock, static_cast<std::size_t>(mCur - mBlock)});
+    } else if (mBlock) {
+      mPool.release(mBlock);
+    }
+    mBlock = mCur = mEnd = nullptr;
+  }
+
+private:
+  block_pool &mPool;
+  std::vector<iovec> &mIov;
+  char *mBlock = nullptr;
+  char *mCur = nullptr;
+  char *mEnd = nullptr;
+};
+
+// precision < 0 selects the shortest round-trip text.
+inline char *writeCoord(char *dst, float v, int precision) {
+  return precision < 0 ? writeF32(dst, v)
+                       : writeFixed(dst, v, static_cast<unsigned>(precision));
+}
+
+inline char *writeTag(char *dst, std::string_view tag) {
+  std::memcpy(dst, tag.data(), tag.size());
+  return dst + tag.size();
+}
+
+inline char *writeVec3(char *dst, std::string_view tag, const vec3f &v,
+                       int precision) {
+  dst = writeTag(dst, tag);
+  dst = writeCoord(dst, v.x, precision);
+  *dst++ = ' ';
+  dst = writeCoord(dst, v.y, precision);
+  *dst++ = ' ';
+  dst = writeCoord(dst, v.z, precision);
+  *dst++ = '\n';
+  return dst;
+}
+
+inline char *writeObjIndex(char *dst, idx_t x) {
+  return writeU64(dst, static_cast<std::size_t>(x) + 1);
+}
+
+inline char *writeCorner(char *dst, const vec3i &c) {
+  *dst++ = ' ';
+  dst = writeObjIndex(dst, c.i);
+  if (c.j == sentinel && c.k == sentinel) {
+    return dst;
+  }
+  *dst++ = '/';
+  if (c.j != sentinel) {
+    dst = writeObjIndex(dst, c.j);
+  }
+  if (c.k != sentinel) {
+    *dst++ = '/';
+    dst = writeObjIndex(dst, c.k);
+  }
+  return dst;
+}
+
+inline void formatObjRun(block_sink &out, const MeshChunk &c, obj_run run,
+                         int precision) {
+  switch (run) {
+  case obj_run::Positions:
+    for (const vec3f &v : c.positions) {
+      out.commit(writeVec3(out.room(kMaxObjElement), "v ", v, precision));
+    }
+    break;
+  case obj_run::Texcoords:
+    for (const vec2f &t : c.texcoords) {
+      char *p = writeTag(out.room(kMaxObjElement), "vt ");
+      p = writeCoord(p, t.u, precision);
+      *p++ = ' ';
+      p = writeCoord(p, t.v, precision);
+      *p++ = '\n';
+      out.commit(p);
+    }
+    break;
+  case obj_run::Normals:
+    for (const vec3f &n : c.normals) {
+      out.commit(writeVec3(out.room(kMaxObjElement), "vn ", n, precision));
+    }
+    break;
+  case obj_run::Faces: {
+    std::size_t ft = 0;
+    for (const idx_t cnt : c.faceSizes) {
+      out.commit(writeTag(out.room(1), "f"));
+      for (std::size_t k = 0; k < cnt; ++k) {
+        out.commit(writeCorner(out.room(kMaxObjElement), c.faceVertices[ft++]));
+      }
+      out.commit(writeTag(out.room(1), "\n"));
+    }
+    break;
+  }
+  }
+}
+
+// ==============================
+// glb export
+// ==============================
+// glTF wants one index per vertex, so corners are deduplicated on their
+// (position, texcoord, normal) triple. Corners are scattered into
+// partitions by hash, each partition numbers its distinct triples on its
+// own, and a prefix sum over the partitions makes the numbers global.
+static constexpr uint32_t kGlbMagic = 0x46546C67;     // "glTF"
+static constexpr uint32_t kGlbJsonChunk = 0x4E4F534A; // "JSON"
+static constexpr uint32_t kGlbBinChunk = 0x004E4942;  // "BIN\0"
+static constexpr std::size_t kGlbViewAlign = 16;
+// Fixed rather than scaled with the CPU count, since the partitions decide
+// the vertex order; 64 keeps a 64-way machine busy.
+static constexpr unsigned kGlbPartitionBits = 6;
+
+inline uint64_t hashCorner(const vec3i &c) {
+  uint64_t h = ((static_cast<uint64_t>(c.i) << 32) | c.j) *
+               0x9E3779B97F4A7C15ull;
+  h ^= (h >> 29) ^ (static_cast<uint64_t>(c.k) * 0xC2B2AE3D27D4EB4Full);
+  h *= 0xBF58476D1CE4E5B9ull;
+  return h ^ (h >> 31);
+}
+
+inline bool sameCorner(const vec3i &a, const vec3i &b) {
+  return a.i == b.i && a.j == b.j && a.k == b.k;
+}
+
+// A corner routed to a partition, with its index in the face tape.
+struct glb_corner {
+  vec3i key;
+  uint32_t corner;
+};
+
+// Open-addressing set of the triples of one partition, numbering them in
+// order of first appearance.
+class corner_table {
+public:
+  explicit corner_table(std::size_t n)
+      : mMask(std::bit_ceil(std::max<std::size_t>(2 * n, 16)) - 1),
+        mSlots(mMask + 1, kEmpty) {}
+
+  uint32_t insert(const vec3i &key, uint64_t hash, std::vector<vec3i> &keys) {
+    for (std::size_t s = hash & mMask;; s = (s + 1) & mMask) {
+      const uint32_t id = mSlots[s];
+      if (id == kEmpty) {
+        mSlots[s] = static_cast<uint32_t>(keys.size());
+        keys.push_back(key);
+        return mSlots[s];
+      }
+      if (sameCorner(keys[id], key)) {
+        return id;
+      }
+    }
+  }
+
+private:
+  static constexpr uint32_t kEmpty = static_cast<uint32_t>(-1);
+  std::size_t mMask;
+  std::vector<uint32_t> mSlots;
+};
+
+inline void appendJsonFloat(std::string &out, float v) {
+  char buf[kMaxFloatChars];
+  out.append(buf, writeF32(buf, std::isfinite(v) ? v : 0.0f));
+}
+
+// ==============================
+// binary cache
+// ==============================
+// saveBinary files are little-endian and laid out as
+//   bin_header | positions | texcoords | normals | face tape | face bounds
+//   | chunks
+// where every section is a raw array starting on a kBinAlign boundary, so
+// loadBinary can map the file and view the arrays in place. The chunk
+// section holds one bin_chunk per batch. A format change bumps kBinVersion.
+static constexpr char kBinMagic[8] = {'M', 'E', 'S', 'H', 'B', 'I', 'N', '\0'};
+static constexpr uint32_t kBinVersion = 1;
+static constexpr std::size_t kBinAlign = 64;
+
+enum bin_section : std::size_t {
+  BinPositions,
+  BinTexcoords,
+  BinNormals,
+  BinFaceTape,
+  BinFaceBounds,
+  BinChunks,
+  BinSections
+};
+
+// Element counts of one batch.
+struct bin_chunk {
+  uint64_t v, t, n, ft, fb;
+};
+
+struct bin_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint64_t file_size;
+  struct {
+    uint64_t offset, count;
+  } sections[BinSections];
+};
+
+static constexpr std::array<std::size_t, BinSections> kBinElemSize = {
+    sizeof(vec3f), sizeof(vec2f), sizeof(vec3f),
+    sizeof(vec3i), sizeof(idx_t), sizeof(bin_chunk)};
+
+static_assert(sizeof(vec3f) == 12 && sizeof(vec2f) == 8 &&
+                  sizeof(vec3i) == 12 && sizeof(bin_chunk) == 40,
+              "binary cache sections are raw arrays of these structs");
+
+inline std::size_t alignBin(std::size_t x) {
+  return (x + kBinAlign - 1) & ~(kBinAlign - 1);
+}
+
+template <class T>
+std::span<const T> binSection(const char *base, const bin_header &h,
+                              bin_section s) {
+  return {reinterpret_cast<const T *>(base + h.sections[s].offset),
+          static_cast<std::size_t>(h.sections[s].count)};
+}
+
+// Cache entry for the file st describes, named by a hash of its identity:
+// any write to the file moves its mtime and so its entry.
+inline std::string cacheEntryPath(const char *dir, const struct stat &st) {
+  const uint64_t fields[] = {static_cast<uint64_t>(st.st_dev),
+                             static_cast<uint64_t>(st.st_ino),
+                             static_cast<uint64_t>(st.st_size),
+                             static_cast<uint64_t>(st.st_mtim.tv_sec),
+                             static_cast<uint64_t>(st.st_mtim.tv_nsec),
+                             kBinVersion};
+  uint64_t h = 0xcbf29ce484222325ull; // FNV-1a
+  for (const uint64_t f : fields) {
+    for (int i = 0; i < 8; ++i) {
+      h = (h ^ ((f >> (8 * i)) & 0xff)) * 0x100000001b3ull;
+    }
+  }
+  char name[32];
+  std::snprintf(name, sizeof(name), "/%016llx.meshbin",
+                static_cast<unsigned long long>(h));
+  return std::string(dir) + name;
+}
+
+inline bool sameFileVersion(const struct stat &a, const struct stat &b) {
+  return a.st_dev == b.st_dev && a.st_ino == b.st_ino &&
+         a.st_size == b.st_size && a.st_mtim.tv_sec == b.st_mtim.tv_sec &&
+         a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+}
+
+// Unmaps a loadBinary file once the Mesh lets go of its views.
+struct file_mapping {
+  void *data;
+  std::size_t size;
+
+  file_mapping(void *data, std::size_t size) : data(data), size(size) {}
+  ~file_mapping() { munmap(data, size); }
+  file_mapping(const file_mapping &) = delete;
+  file_mapping &operator=(const file_mapping &) = delete;
+};
+
+// ==============================
+// ply import
+// ==============================
+// Binary little-endian PLY. The header lists elements, each a count of
+// records made of scalar and list properties; the records follow it back
+// to back, element by element.
+enum class ply_type : uint8_t {
+  Int8,
+  UInt8,
+  Int16,
+  UInt16,
+  Int32,
+  UInt32,
+  Float32,
+  Float64
+};
+
+inline bool parsePlyType(std::string_view name, ply_type &t) {
+  static constexpr std::pair<std::string_view, ply_type> kNames[] = {
+      {"char", ply_type::Int8},      {"int8", ply_type::Int8},
+      {"uchar", ply_type::UInt8},    {"uint8", ply_type::UInt8},
+      {"short", ply_type::Int16},    {"int16", ply_type::Int16},
+      {"ushort", ply_type::UInt16},  {"uint16", ply_type::UInt16},
+      {"int", ply_type::Int32},      {"int32", ply_type::Int32},
+      {"uint", ply_type::UInt32},    {"uint32", ply_type::UInt32},
+      {"float", ply_type::Float32},  {"float32", ply_type::Float32},
+      {"double", ply_type::Float64}, {"float64", ply_type::Float64}};
+  for (const auto &[n, type] : kNames) {
+    if (n == name) {
+      t = type;
+      return true;
+    }
+  }
+  return false;
+}
+
+inline std::size_t plySize(ply_type t) {
+  static constexpr std::size_t kSizes[] = {1, 1, 2, 2, 4, 4, 4, 8};
+  return kSizes[static_cast<std::size_t>(t)];
+}
+
+template <class T> inline T loadLe(const char *p) {
+  T v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline double plyValue(const char *p, ply_type t) {
+  switch (t) {
+  case ply_type::Int8:
+    return loadLe<int8_t>(p);
+  case ply_type::UInt8:
+    return loadLe<uint8_t>(p);
+  case ply_type::Int16:
+    return loadLe<int16_t>(p);
+  case ply_type::UInt16:
+    return loadLe<uint16_t>(p);
+  case ply_type::Int32:
+    return loadLe<int32_t>(p);
+  case ply_type::UInt32:
+    return loadLe<uint32_t>(p);
+  case ply_type::Float32:
+    return loadLe<float>(p);
+  case ply_type::Float64:
+    return loadLe<double>(p);
+  }
+  return 0;
+}
+
+inline int64_t plyInt(const char *p, ply_type t) {
+  switch (t) {
+  case ply_type::Int8:
+    return loadLe<int8_t>(p);
+  case ply_type::UInt8:
+    return loadLe<uint8_t>(p);
+  case ply_type::Int16:
+    return loadLe<int16_t>(p);
+  case ply_type::UInt16:
+    return loadLe<uint16_t>(p);
+  case ply_type::Int32:
+    return loadLe<int32_t>(p);
+  case ply_type::UInt32:
+    return loadLe<uint32_t>(p);
+  default:
+    return static_cast<int64_t>(plyValue(p, t));
+  }
+}
+
+struct ply_property {
+  std::string name;
+  ply_type type;       // of the value, or of each list item
+  bool list;
+  ply_type count_type; // lists only
+  std::size_t offset;  // within the record, while it is fixed-size
+};
+
+struct ply_element {
+  std::string name;
+  std::size_t count;
+  std::vector<ply_property> props;
+  bool fixed = true;      // no list properties
+  std::size_t stride = 0; // record size when fixed
+
+  const ply_property *find(std::string_view n) const {
+    for (const ply_property &p : props) {
+      if (p.name == n) {
+        return &p;
+      }
+    }
+    return nullptr;
+  }
+};
+
+// Reads the header of a binary little-endian PLY file into elements and
+// sets body to the offset of the first record.
+inline bool parsePlyHeader(const char *data, std::size_t size,
+                           std::vector<ply_element> &elements,
+                           std::size_t &body) {
+  std::string_view text(data, size);
+  std::size_t pos = 0;
+  auto nextLine = [&](std::string_view &line) {
+    const std::size_t nl = text.find('\n', pos);
+    if (nl == std::string_view::npos) {
+      return false;
+    }
+    line = text.substr(pos, nl - pos);
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    pos = nl + 1;
+    return true;
+  };
+
+  std::string_view line;
+  if (!nextLine(line) || line != "ply" || !nextLine(line)) {
+    return false;
+  }
+  std::size_t tp = 0;
+  if (nextToken(line, tp) != "format" ||
+      nextToken(line, tp) != "binary_little_endian") {
+    return false;
+  }
+
+  while (nextLine(line)) {
+    std::size_t lp = 0;
+    const std::string_view key = nextToken(line, lp);
+    if (key == "end_header") {
+      body = pos;
+      return true;
+    }
+    if (key == "element") {
+      const std::string_view name = nextToken(line, lp);
+      bool ok = false;
+      const long count = parseLong(nextToken(line, lp), ok);
+      if (!ok || count < 0) {
+        return false;
+      }
+      elements.push_back(
+          ply_element{std::string(name), static_cast<std::size_t>(count), {}});
+    } else if (key == "property") {
+      if (elements.empty()) {
+        return false;
+      }
+      ply_element &e = elements.back();
+      ply_property p{};
+      std::string_view type = nextToken(line, lp);
+      if (type == "list") {
+        p.list = true;
+        if (!parsePlyType(nextToken(line, lp), p.count_type)) {
+          return false;
+        }
+        type = nextToken(line, lp);
+      }
+      if (!parsePlyType(type, p.type)) {
+        return false;
+      }
+      p.name = std::string(nextToken(line, lp));
+      p.offset = e.stride;
+      e.fixed = e.fixed && !p.list;
+      e.stride += p.list ? 0 : plySize(p.type);
+      e.props.push_back(std::move(p));
+    }
+    // comment and obj_info lines are skipped
+  }
+  return false;
+}
+
+// Steps over the record at p, which must end by end. Reports the item
+// count and first item of the list property list, if it is not null.
+// Returns nullptr if the record is cut off.
+inline const char *nextPlyRecord(const ply_element &e, const char *p,
+                                 const char *end, const ply_property *list,
+                                 std::size_t &count, const char *&items) {
+  for (const ply_property &prop : e.props) {
+    if (!prop.list) {
+      p += plySize(prop.type);
+      continue;
+    }
+    const std::size_t cs = plySize(prop.count_type);
+    if (p > end || static_cast<std::size_t>(end - p) < cs) {
+      return nullptr;
+    }
+    const int64_t n = plyInt(p, prop.count_type);
+    p += cs;
+    if (n < 0 ||
+        static_cast<uint64_t>(n) > (end - p) / plySize(prop.type)) {
+      return nullptr;
+    }
+    if (&prop == list) {
+      count = static_cast<std::size_t>(n);
+      items = p;
+    }
+    p += static_cast<std::size_t>(n) * plySize(prop.type);
+  }
+  return p <= end ? p : nullptr;
+}
+
+// Where a run of face records starts, found by the sequential pass so the
+// runs can be decoded in parallel.
+struct ply_face_chunk {
+  const char *data;
+  std::size_t face_begin, corner_begin;
+};
+
+// ==============================
+// Mesh
+// ==============================
+class _MeshImpl {
+public:
+  mesh_config mConfig;
+  std::vector<consumer_store> mConsumerStores;
+  std::vector<batch> mBatches;
+  std::vector<batch_artifact> mBatchArtifacts;
+  bool mContiguous = false; // one store, artifacts in file order
+  std::unique_ptr<file_mapping> mMapping; // set by loadBinary
+  store_view mMapped;                     // arrays inside mMapping
+  PerfMetrics mPerf;                      // of the last import
+  ThreadPool *mPool;
+
+  explicit _MeshImpl(ThreadPool &pool) : mConfig{}, mPool(&pool) {}
+
+  // Drops any previously imported geometry.
+  void reset() {
+    mConsumerStores.clear();
+    mConsumerStores.resize(mConfig.num_consumers);
+    mBatches.clear();
+    mBatchArtifacts.clear();
+    mContiguous = false;
+    mMapped = {};
+    mMapping.reset();
+    mPerf.reset();
+  }
+
+  store_view view(std::size_t consumer_id) const {
+    if (mMapping) {
+      return mMapped;
+    }
+    const consumer_store &cs = mConsumerStores[consumer_id];
+    return {cs.vertices, cs.textures, cs.normals, cs.face_tape,
+            cs.face_bounds};
+  }
+
+  MeshChunk chunk(std::size_t i) const {
+    const batch_artifact &a = mBatchArtifacts[i];
+    const store_view s = view(a.consumer_id);
+    auto sub = [](auto arr, range r) {
+      return arr.subspan(r.begin, r.end - r.begin);
     };
-    auto emitFaceVertex = [&](const vec3i &tri) {
-      out += " ";
-      if (tri.j == sentinel && tri.k == sentinel) {
-        emitIndex(tri.i);
-      } else if (tri.j != sentinel && tri.k == sentinel) {
-        emitIndex(tri.i);
-        out += "/";
-        emitIndex(tri.j);
-      } else if (tri.j == sentinel && tri.k != sentinel) {
-        emitIndex(tri.i);
-        out += "//";
-        emitIndex(tri.k);
+    return MeshChunk{sub(s.vertices, a.v), sub(s.textures, a.t),
+                     sub(s.normals, a.n), sub(s.face_tape, a.ft),
+                     sub(s.face_bounds, a.fb)};
+  }
+
+  // Element totals over every batch, in consumer_store order.
+  consumer_sizes totals() const {
+    consumer_sizes z{};
+    for (const batch_artifact &a : mBatchArtifacts) {
+      z.v += a.v.end - a.v.begin;
+      z.t += a.t.end - a.t.begin;
+      z.n += a.n.end - a.n.begin;
+      z.ft += a.ft.end - a.ft.begin;
+      z.fb += a.fb.end - a.fb.begin;
+    }
+    return z;
+  }
+
+  // Imports the OBJ text in [obj, obj + file_size), or the text it holds
+  // if it is compressed. Only a private file mapping is releasable, i.e.
+  // may stream and have its pages dropped.
+  bool importObj(const void *obj, std::size_t file_size,
+                 const MeshImportOptions &options, bool releasable = false) {
+    const char *text = static_cast<const char *>(obj);
+    if (const compression c = detectCompression(text, file_size);
+        c != compression::None) {
+      return importCompressed(c, text, file_size, options);
+    }
+
+    mConfig = resolveConfig(options, obj, file_size);
+    if (!releasable) {
+      mConfig.stream_window = 0;
+    }
+    reset();
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    const char *data = static_cast<const char *>(obj);
+    std::size_t off = 0;
+    while (mConfig.stream_window == 0 && off < file_size) {
+      const range r = build_range(data, file_size, off, mConfig.batch_size);
+      const std::size_t id = mBatches.size();
+      mBatches.push_back(
+          batch{data + r.begin, r.end - r.begin, id, 0, 0, 0, true});
+    }
+    mBatchArtifacts.resize(mBatches.size());
+
+    if (!runImport(data, file_size)) {
+      return false;
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> diff = end_time - start_time;
+    if (mConfig.print_stats) {
+      printStats(diff.count(), file_size);
+    }
+    return true;
+  }
+
+  // Imports the binary little-endian PLY file in [data, data + size). One
+  // sequential pass steps over the face records to find where each chunk
+  // of them starts and how many corners precede it; vertex and face chunks
+  // are then decoded in parallel straight into a single store.
+  bool importPly(const char *data, std::size_t size,
+                 const MeshImportOptions &options) {
+    if constexpr (std::endian::native != std::endian::little) {
+      return false;
+    }
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    std::vector<ply_element> elements;
+    std::size_t body = 0;
+    if (!parsePlyHeader(data, size, elements, body)) {
+      return false;
+    }
+
+    const ply_element *vert = nullptr, *face = nullptr;
+    const ply_property *list = nullptr;
+    const char *vbase = nullptr;
+    const char *p = data + body;
+    const char *const end = data + size;
+    mConfig = resolveConfig(options, nullptr, size);
+    std::vector<ply_face_chunk> face_chunks;
+    std::size_t corners = 0;
+
+    for (const ply_element &e : elements) {
+      if (vert && face) {
+        break;
+      }
+      const bool is_face = !face && e.name == "face";
+      if (is_face) {
+        face = &e;
+        list = e.find("vertex_indices");
+        list = list ? list : e.find("vertex_index");
+        if (!list || !list->list) {
+          return false;
+        }
+      } else if (!vert && e.name == "vertex") {
+        if (!e.fixed) {
+          return false;
+        }
+        vert = &e;
+        vbase = p;
+      }
+
+      if (e.fixed && !is_face) {
+        if (e.stride &&
+            e.count > static_cast<std::size_t>(end - p) / e.stride) {
+          return false;
+        }
+        p += e.count * e.stride;
+        continue;
+      }
+      // The sequential pass, for the faces and any other element of
+      // variable-size records in front of the ones needed.
+      const char *chunk_start = p;
+      for (std::size_t i = 0; i < e.count; ++i) {
+        if (is_face && (i == 0 || static_cast<std::size_t>(p - chunk_start) >=
+                                      mConfig.batch_size)) {
+          face_chunks.push_back(ply_face_chunk{p, i, corners});
+          chunk_start = p;
+        }
+        std::size_t n = 0;
+        const char *items = nullptr;
+        p = nextPlyRecord(e, p, end, list, n, items);
+        if (!p) {
+          return false;
+        }
+        corners += n;
+      }
+    }
+    if (!vert || vert->count >= sentinel || corners >= sentinel) {
+      return false;
+    }
+
+    const std::size_t nv = vert->count;
+    const std::size_t nf = face ? face->count : 0;
+    const ply_property *x = vert->find("x"), *y = vert->find("y"),
+                       *z = vert->find("z");
+    const ply_property *nx = vert->find("nx"), *ny = vert->find("ny"),
+                       *nz = vert->find("nz");
+    const ply_property *u = nullptr, *v = nullptr;
+    for (const auto &[un, vn] : {std::pair{"s", "t"}, std::pair{"u", "v"},
+                                 std::pair{"texture_u", "texture_v"},
+                                 std::pair{"texture_s", "texture_t"}}) {
+      if (!u || !v) {
+        u = vert->find(un);
+        v = vert->find(vn);
+      }
+    }
+    if (!x || !y || !z) {
+      return false;
+    }
+    const bool has_n = nx && ny && nz;
+    const bool has_t = u && v;
+
+    reset();
+    consumer_store &store = mConsumerStores[0];
+    store.vertices.resize(nv);
+    store.normals.resize(has_n ? nv : 0);
+    store.textures.resize(has_t ? nv : 0);
+    store.face_bounds.resize(nf);
+    store.face_tape.resize(corners);
+
+    const std::size_t per_chunk =
+        std::max<std::size_t>(1, mConfig.batch_size / std::max<std::size_t>(
+                                                          vert->stride, 1));
+    const std::size_t vchunks = (nv + per_chunk - 1) / per_chunk;
+    const std::size_t stride = vert->stride;
+    // The usual layout starts with three floats, which copy as a vec3f.
+    const bool packed_xyz = x->type == ply_type::Float32 &&
+                            y->type == ply_type::Float32 &&
+                            z->type == ply_type::Float32 && x->offset == 0 &&
+                            y->offset == 4 && z->offset == 8;
+
+    mBatchArtifacts.resize(vchunks + face_chunks.size());
+    parallelFor(*mPool, mConfig.num_consumers, mBatchArtifacts.size(),
+                [&](std::size_t bid) {
+      batch_artifact &a = mBatchArtifacts[bid];
+      a = batch_artifact{};
+      a.batch_id = bid;
+      if (bid < vchunks) {
+        const std::size_t b = bid * per_chunk;
+        const std::size_t e = std::min(nv, b + per_chunk);
+        for (std::size_t i = b; i < e; ++i) {
+          const char *r = vbase + i * stride;
+          vec3f &pos = store.vertices[i];
+          if (packed_xyz) {
+            std::memcpy(&pos, r, sizeof(vec3f));
+          } else {
+            pos = {static_cast<float>(plyValue(r + x->offset, x->type)),
+                   static_cast<float>(plyValue(r + y->offset, y->type)),
+                   static_cast<float>(plyValue(r + z->offset, z->type))};
+          }
+          if (has_n) {
+            store.normals[i] = {
+                static_cast<float>(plyValue(r + nx->offset, nx->type)),
+                static_cast<float>(plyValue(r + ny->offset, ny->type)),
+                static_cast<float>(plyValue(r + nz->offset, nz->type))};
+          }
+          if (has_t) {
+            store.textures[i] = {
+                static_cast<float>(plyValue(r + u->offset, u->type)),
+                static_cast<float>(plyValue(r + v->offset, v->type))};
+          }
+        }
+        a.v = {b, e};
+        a.t = has_t ? range{b, e} : range{};
+        a.n = has_n ? range{b, e} : range{};
+        a.lines = {e - b, has_t ? e - b : 0, has_n ? e - b : 0};
+        return;
+      }
+
+      const std::size_t fc = bid - vchunks;
+      const ply_face_chunk &c = face_chunks[fc];
+      const std::size_t fe = fc + 1 < face_chunks.size()
+                                 ? face_chunks[fc + 1].face_begin
+                                 : nf;
+      const std::size_t isz = plySize(list->type);
+      const char *r = c.data;
+      std::size_t ft = c.corner_begin;
+      for (std::size_t f = c.face_begin; f < fe; ++f) {
+        std::size_t n = 0;
+        const char *items = nullptr;
+        r = nextPlyRecord(*face, r, end, list, n, items);
+        store.face_bounds[f] = static_cast<idx_t>(n);
+        for (std::size_t k = 0; k < n; ++k) {
+          const int64_t idx = plyInt(items + k * isz, list->type);
+          const idx_t i = (idx >= 0 && idx < static_cast<int64_t>(nv))
+                              ? static_cast<idx_t>(idx)
+                              : sentinel;
+          store.face_tape[ft++] = {i, has_t ? i : sentinel,
+                                   has_n ? i : sentinel};
+        }
+      }
+      a.ft = {c.corner_begin, ft};
+      a.fb = {c.face_begin, fe};
+    });
+    mContiguous = true;
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> diff = end_time - start_time;
+    if (mConfig.print_stats) {
+      printStats(diff.count(), size, false);
+    }
+    return true;
+  }
+
+  // Imports a regular file through a read ring, with io_uring when it is
+  // built in and can be set up, and with pread threads otherwise. A
+  // file_size of kUnknownSize reads a pipe or socket to its end, tuned as
+  // for a large file.
+  bool importRead(int fd, std::size_t file_size,
+                  const MeshImportOptions &options) {
+    std::unique_ptr<slot_ring> ring = beginRingImport(options, file_size);
+    const pread_fill fill{fd, file_size, ring->slot_size, isDirectFd(fd)};
+    if (file_size == kUnknownSize) {
+      pread_source src(fill, *ring, 1);
+      return runRing(src, *ring);
+    }
+#ifdef MESH_HAVE_LIBURING
+    {
+      uring_source src(fd, file_size, *ring);
+      if (src.ok()) {
+        return runRing(src, *ring);
+      }
+    }
+#endif
+    pread_source src(fill, *ring, std::min<std::size_t>(4, ring->num_slots));
+    return runRing(src, *ring);
+  }
+
+  // Decompresses into a read ring while the consumers parse, so the import
+  // runs at decompressor speed. gzip inflates on one pipelined worker. zstd
+  // frames that record their size and fit a ring slot decompress in
+  // parallel, one worker per consumer; other zstd input streams on one.
+  // Fails if support for the format was not built in.
+  bool importCompressed(compression c, [[maybe_unused]] const char *data,
+                        std::size_t size,
+                        [[maybe_unused]] const MeshImportOptions &options) {
+    // OBJ text typically compresses about 4:1.
+    [[maybe_unused]] const std::size_t hint = 4 * size;
+    if (c == compression::Gzip) {
+#ifdef MESH_HAVE_ZLIB
+      std::unique_ptr<slot_ring> ring = beginRingImport(options, hint);
+      threaded_source<gzip_fill> src(gzip_fill(data, size, ring->slot_size),
+                                     *ring, 1);
+      return runRing(src, *ring);
+#else
+      return false;
+#endif
+    }
+
+#ifdef MESH_HAVE_ZSTD
+    std::vector<zstd_frame> frames;
+    if (indexZstdFrames(data, size, frames) && !frames.empty()) {
+      std::unique_ptr<slot_ring> ring =
+          beginRingImport(options, frames.back().end);
+      std::size_t largest = 0;
+      for (const zstd_frame &f : frames) {
+        largest = std::max(largest, f.end - f.begin);
+      }
+      if (largest <= ring->slot_size) {
+        threaded_source<zstd_frame_fill> src(
+            zstd_frame_fill{&frames, ring->slot_size}, *ring,
+            std::min(mConfig.num_consumers, ring->num_slots));
+        return runRing(src, *ring);
+      }
+      threaded_source<zstd_stream_fill> src(
+          zstd_stream_fill(data, size, ring->slot_size), *ring, 1);
+      return runRing(src, *ring);
+    }
+    std::unique_ptr<slot_ring> ring = beginRingImport(options, hint);
+    threaded_source<zstd_stream_fill> src(
+        zstd_stream_fill(data, size, ring->slot_size), *ring, 1);
+    return runRing(src, *ring);
+#else
+    return false;
+#endif
+  }
+
+  // Resolves the config for a ring-fed import of about size_hint bytes and
+  // sizes its ring: pieces of a few batches, a few more slots than
+  // consumers so every consumer has work while pieces are being filled.
+  std::unique_ptr<slot_ring> beginRingImport(const MeshImportOptions &options,
+                                             std::size_t size_hint) {
+    mConfig = resolveConfig(options, nullptr, size_hint);
+    mConfig.mode = MeshImportEngine::Pipeline;
+    mConfig.stream_window = 0;
+    reset();
+
+    static constexpr std::size_t kMinSlot = 64 * 1024;
+    static constexpr std::size_t kMaxSlot = 16 * 1024 * 1024;
+    const std::size_t slot =
+        options.readBufferSize
+            ? std::bit_ceil(std::max(options.readBufferSize, kMinSlot))
+            : std::clamp(4 * mConfig.batch_size, kMinSlot, kMaxSlot);
+    mConfig.batch_size = std::min(mConfig.batch_size, slot);
+    return std::make_unique<slot_ring>(mConfig.num_consumers + 3, slot);
+  }
+
+  // Runs the pipeline with ringProducerWork as the producer and the
+  // source's fill workers on the same pool, after the consumers. Consumers
+  // keep their artifacts locally, since the batch count is only known at
+  // the end, and release each batch's slot once it is parsed.
+  template <class Source> bool runRing(Source &src, slot_ring &ring) {
+    auto start_time = std::chrono::high_resolution_clock::now();
+    const std::size_t nc = mConfig.num_consumers;
+    std::deque<batch> batches;
+    std::vector<std::vector<batch_artifact>> parsed(nc);
+    SPMCQueue<batch *> queue(mConfig.queue_capacity);
+    bool ok = true;
+    mPool->run(nc + 1 + src.workers(), [&](std::size_t tid) {
+      if (tid == 0) {
+        ok = ringProducerWork(queue, mConfig, src, ring, batches);
+        src.stop();
+      } else if (tid > nc) {
+        src.work();
+      } else {
+        consumerWork(queue, mConsumerStores[tid - 1], tid - 1, mConfig.wait,
+                     mPerf, [&](const batch &b, const batch_artifact &a) {
+                       parsed[tid - 1].push_back(a);
+                       ring.release(ring.slotOf(b.data));
+                     });
+      }
+    });
+    std::size_t bytes = 0;
+    for (const batch &b : batches) {
+      bytes += b.size;
+    }
+    if (!ok || bytes == 0) {
+      return false;
+    }
+    mBatchArtifacts.resize(batches.size());
+    for (const auto &v : parsed) {
+      for (const batch_artifact &a : v) {
+        mBatchArtifacts[a.batch_id] = a;
+      }
+    }
+    resolveDeferred();
+    if (mConfig.merge) {
+      mergeStores();
+    }
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> diff = end_time - start_time;
+    if (mConfig.print_stats) {
+      printStats(diff.count(), bytes);
+    }
+    return true;
+  }
+
+  // Fills in the options left at 0. Threads default to every CPU in the
+  // affinity mask, capped so each gets a few batches and so the team does
+  // not ask for more bandwidth than the probe measured; batches are sized
+  // for about 16 per thread.
+  mesh_config resolveConfig(const MeshImportOptions &options, const void *obj,
+                            std::size_t file_size) {
+    const std::size_t cpus = affinityCpuCount();
+    mesh_config config{};
+    config.mode = options.engine;
+    config.merge = options.merge;
+    config.print_stats = options.printStats;
+    config.wait = spmc_wait_policy{options.spinIterations,
+                                   options.yieldIterations, options.park};
+
+    static constexpr std::size_t kMinBatch = 64 * 1024;
+    static constexpr std::size_t kMaxBatch = 4 * 1024 * 1024;
+    static constexpr std::size_t kProbeThreshold = 64 * 1024 * 1024;
+
+    std::size_t threads = options.numThreads;
+    if (threads == 0) {
+      const std::size_t per_batch =
+          options.batchSize ? options.batchSize : kMinBatch;
+      threads = std::clamp<std::size_t>(file_size / (4 * per_batch), 1, cpus);
+      if (threads > 1 && obj && file_size >= kProbeThreshold) {
+        const double bw = memoryBandwidth(*mPool, cpus);
+        const double rate = parseRate(obj, file_size);
+        if (bw > 0 && rate > 0) {
+          const auto fit = static_cast<std::size_t>(bw / rate + 0.5);
+          threads = std::clamp<std::size_t>(fit, 1, threads);
+        }
+      }
+    }
+    config.num_consumers = threads;
+
+    config.batch_size = options.batchSize;
+    if (config.batch_size == 0) {
+      config.batch_size = std::bit_ceil(
+          std::clamp(file_size / (threads * 16), kMinBatch, kMaxBatch));
+    }
+    config.queue_capacity =
+        options.queueCapacity ? options.queueCapacity : 4 * threads;
+
+    // Only the pipeline producer can pace the input, and the window must
+    // hold a few batches.
+    config.stream_window = options.streamWindow;
+    if (config.stream_window) {
+      config.mode = MeshImportEngine::Pipeline;
+      config.batch_size = std::min(
+          config.batch_size,
+          std::max<std::size_t>(config.stream_window / 4, 4096));
+    }
+    return config;
+  }
+
+  static std::size_t affinityCpuCount() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+      return std::max(1, CPU_COUNT(&set));
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  // Aggregate read bandwidth in bytes/s, measured once per process by
+  // streaming a 64 MiB buffer from every thread.
+  static double memoryBandwidth(ThreadPool &pool, std::size_t threads) {
+    static const double bw = [&pool, threads]() {
+      static constexpr std::size_t kBytes = 64 * 1024 * 1024;
+      buffer<uint64_t> buf(kBytes / sizeof(uint64_t));
+      const std::size_t words = buf.size() / threads;
+      std::atomic<uint64_t> sink{0};
+      pool.run(threads, [&](std::size_t tid) {
+        uint64_t *p = buf.data() + tid * words;
+        for (std::size_t i = 0; i < words; ++i) {
+          p[i] = i;
+        }
+      });
+
+      auto t0 = std::chrono::steady_clock::now();
+      pool.run(threads, [&](std::size_t tid) {
+        const uint64_t *p = buf.data() + tid * words;
+        uint64_t a = 0, b = 0, c = 0, d = 0;
+        for (std::size_t i = 0; i + 4 <= words; i += 4) {
+          a += p[i];
+          b += p[i + 1];
+          c += p[i + 2];
+          d += p[i + 3];
+        }
+        sink += a + b + c + d;
+      });
+      std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+      return dt.count() > 0 ? (words * threads * sizeof(uint64_t)) / dt.count()
+                            : 0.0;
+    }();
+    return bw;
+  }
+
+  // Single-thread parse speed in bytes/s, sampled on the first MiB of the
+  // input. The sample is kept out of the perf report.
+  static double parseRate(const void *obj, std::size_t file_size) {
+    const char *data = static_cast<const char *>(obj);
+    std::size_t off = 0;
+    const range r = build_range(data, file_size, off, 1024 * 1024);
+    const batch b{data + r.begin, r.end - r.begin, 0, 0, 0, 0, true};
+    consumer_store scratch;
+    PerfMetrics scratch_perf;
+    auto t0 = std::chrono::steady_clock::now();
+    (void)parseBatch(b, scratch, 0, scratch_perf);
+    std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+
+    return dt.count() > 0 ? b.size / dt.count() : 0.0;
+  }
+
+  bool runImport(const char *data, std::size_t file_size) {
+    bool ok = false;
+    switch (mConfig.mode) {
+    case MeshImportEngine::Pipeline:
+      ok = mConfig.stream_window ? importStream(data, file_size)
+                                 : importPipeline(file_size);
+      break;
+    case MeshImportEngine::TwoPhase:
+      ok = importTwoPhase();
+      break;
+    case MeshImportEngine::WorkStealing:
+      ok = importWorkStealing(file_size);
+      break;
+    }
+    if (ok && mConfig.merge) {
+      mergeStores();
+    }
+    return ok;
+  }
+
+  void reserveStores(std::size_t file_size) {
+    const std::size_t num_consumers = mConsumerStores.size();
+    auto start_alloc = std::chrono::high_resolution_clock::now();
+    for (std::size_t i = 0; i < num_consumers; ++i) {
+      mConsumerStores[i].vertices.reserve(file_size / (num_consumers * 48));
+      mConsumerStores[i].textures.reserve(file_size / (num_consumers * 80));
+      mConsumerStores[i].normals.reserve(file_size / (num_consumers * 48));
+      mConsumerStores[i].face_tape.reserve(file_size / (num_consumers * 64));
+      mConsumerStores[i].face_bounds.reserve(file_size / (num_consumers * 48));
+    }
+    auto end_alloc = std::chrono::high_resolution_clock::now();
+    mPerf.alloc_time_ns +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end_alloc -
+                                                             start_alloc)
+            .count();
+  }
+
+  bool importPipeline(std::size_t file_size) {
+    reserveStores(file_size);
+    // The producer takes tid 0, consumer i runs as tid i + 1.
+    SPMCQueue<batch *> queue(mConfig.queue_capacity);
+    mPool->run(mConfig.num_consumers + 1, [this, &queue](std::size_t tid) {
+      if (tid == 0) {
+        producerWork(queue, mConfig, mBatches.data(), mBatches.size());
+      } else {
+        consumerWork(queue, mConsumerStores[tid - 1], tid - 1, mConfig.wait,
+                     mPerf, [this](const batch &b, const batch_artifact &a) {
+                       mBatchArtifacts[b.batch_id] = a;
+                     });
+      }
+    });
+    resolveDeferred();
+    return true;
+  }
+
+  // importPipeline over a mapping that is not resident yet: the producer
+  // cuts batches as the window frees up, so every batch except the last is
+  // at least batch_size bytes and their count is bounded up front.
+  bool importStream(const char *data, std::size_t file_size) {
+    reserveStores(file_size);
+    const std::size_t max_batches =
+        (file_size + mConfig.batch_size - 1) / mConfig.batch_size;
+    mBatches.reserve(max_batches);
+    mBatchArtifacts.resize(max_batches);
+
+    stream_state stream(max_batches);
+    SPMCQueue<batch *> queue(mConfig.queue_capacity);
+    mPool->run(mConfig.num_consumers + 1, [&](std::size_t tid) {
+      if (tid == 0) {
+        streamProducerWork(queue, mConfig, data, file_size, mBatches, stream);
       } else {
-        emitIndex(tri.i);
-        out += "/";
-        emitIndex(tri.j);
-        out += "/";
-        emitIndex(tri.k);
+        consumerWork(queue, mConsumerStores[tid - 1], tid - 1, mConfig.wait,
+                     mPerf, [&](const batch &b, const batch_artifact &a) {
+                       mBatchArtifacts[b.batch_id] = a;
+                       stream.finish(b.batch_id);
+                     });
+      }
+    });
+    mBatchArtifacts.resize(mBatches.size());
+    resolveDeferred();
+    return true;
+  }
+
+  // Each thread owns a deque seeded with a contiguous run of batches and
+  // pops them in file order; once it runs dry it steals from the far end of
+  // the other deques. Nothing is pushed after seeding, so a thread may stop
+  // as soon as every deque is empty.
+  bool importWorkStealing(std::size_t file_size) {
+    reserveStores(file_size);
+    const std::size_t num_threads = mConfig.num_consumers;
+    const std::size_t nb = mBatches.size();
+
+    std::vector<std::unique_ptr<WSDeque<batch *>>> deques;
+    deques.reserve(num_threads);
+    for (std::size_t t = 0; t < num_threads; ++t) {
+      const std::size_t lo = nb * t / num_threads;
+      const std::size_t hi = nb * (t + 1) / num_threads;
+      deques.push_back(
+          std::make_unique<WSDeque<batch *>>(std::max<std::size_t>(hi - lo, 1)));
+      for (std::size_t i = hi; i > lo; --i) {
+        deques[t]->push(&mBatches[i - 1]);
+      }
+    }
+
+    mPool->run(num_threads, [&](std::size_t tid) {
+      consumer_store &store = mConsumerStores[tid];
+      WSDeque<batch *> &own = *deques[tid];
+      batch *b{};
+      for (;;) {
+        if (own.pop(b)) {
+          mBatchArtifacts[b->batch_id] = parseBatch(*b, store, tid, mPerf);
+          continue;
+        }
+
+        uint64_t _t0 = rdtsc();
+        bool stole = false, any_left = false;
+        for (std::size_t k = 1; k < num_threads && !stole; ++k) {
+          WSDeque<batch *> &victim = *deques[(tid + k) % num_threads];
+          while (!victim.empty()) {
+            any_left = true;
+            if (victim.steal(b)) {
+              stole = true;
+              break;
+            }
+          }
+        }
+        mPerf.wait_cycles += (rdtsc() - _t0);
+
+        if (stole) {
+          mBatchArtifacts[b->batch_id] = parseBatch(*b, store, tid, mPerf);
+        } else if (!any_left) {
+          break;
+        }
+      }
+    });
+
+    resolveDeferred();
+    return true;
+  }
+
+  // Adds each batch's global v/vt/vn base to the relative indices its
+  // consumer left batch-local.
+  void resolveDeferred() {
+    const std::size_t nb = mBatchArtifacts.size();
+    std::vector<line_counts> bases(nb);
+    line_counts run{0, 0, 0};
+    std::size_t total_fixups = 0;
+    for (std::size_t i = 0; i < nb; ++i) {
+      const batch_artifact &a = mBatchArtifacts[i];
+      bases[i] = run;
+      run.v += a.lines.v;
+      run.t += a.lines.t;
+      run.n += a.lines.n;
+      total_fixups += a.fx.end - a.fx.begin;
+    }
+    if (total_fixups == 0) {
+      return;
+    }
+
+    parallelFor(*mPool, mConfig.num_consumers, nb, [&](std::size_t i) {
+      const batch_artifact &a = mBatchArtifacts[i];
+      consumer_store &cs = mConsumerStores[a.consumer_id];
+      const std::size_t base[3] = {bases[i].v, bases[i].t, bases[i].n};
+      for (std::size_t f = a.fx.begin; f < a.fx.end; ++f) {
+        const std::size_t slot = cs.fixups[f];
+        vec3i &c = cs.face_tape[slot / 3];
+        idx_t &x = (slot % 3 == 0) ? c.i : (slot % 3 == 1) ? c.j : c.k;
+        const long v =
+            static_cast<long>(base[slot % 3]) + static_cast<int32_t>(x);
+        x = (v >= 0 && v < static_cast<long>(sentinel)) ? static_cast<idx_t>(v)
+                                                         : sentinel;
+      }
+    });
+  }
+
+  // Gathers every batch into one store in file order, so the geometry is
+  // contiguous and each artifact's ranges become global offsets.
+  void mergeStores() {
+    const std::size_t nb = mBatchArtifacts.size();
+    bool in_order = true;
+    std::size_t v = 0, t = 0, n = 0, ft = 0, fb = 0;
+    for (const batch_artifact &a : mBatchArtifacts) {
+      in_order = in_order && a.consumer_id == 0 && a.v.begin == v &&
+                 a.t.begin == t && a.n.begin == n && a.ft.begin == ft &&
+                 a.fb.begin == fb;
+      v += a.v.end - a.v.begin;
+      t += a.t.end - a.t.begin;
+      n += a.n.end - a.n.begin;
+      ft += a.ft.end - a.ft.begin;
+      fb += a.fb.end - a.fb.begin;
+    }
+    if (in_order && mConsumerStores.size() == 1) {
+      mConsumerStores[0].fixups = {};
+      mContiguous = true;
+      return;
+    }
+
+    auto start_alloc = std::chrono::high_resolution_clock::now();
+    consumer_store merged;
+    merged.vertices.resize(v);
+    merged.textures.resize(t);
+    merged.normals.resize(n);
+    merged.face_tape.resize(ft);
+    merged.face_bounds.resize(fb);
+    auto end_alloc = std::chrono::high_resolution_clock::now();
+    mPerf.alloc_time_ns +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end_alloc -
+                                                             start_alloc)
+            .count();
+
+    std::vector<batch_artifact> global(nb);
+    v = t = n = ft = fb = 0;
+    auto place = [](range r, std::size_t &off) {
+      const range g{off, off + (r.end - r.begin)};
+      off = g.end;
+      return g;
+    };
+    for (std::size_t i = 0; i < nb; ++i) {
+      const batch_artifact &a = mBatchArtifacts[i];
+      batch_artifact &g = global[i];
+      g.batch_id = a.batch_id;
+      g.consumer_id = 0;
+      g.v = place(a.v, v);
+      g.t = place(a.t, t);
+      g.n = place(a.n, n);
+      g.ft = place(a.ft, ft);
+      g.fb = place(a.fb, fb);
+      g.fx = range{0, 0};
+      g.lines = a.lines;
+    }
+
+    parallelFor(*mPool, mConfig.num_consumers, nb, [&](std::size_t i) {
+      const batch_artifact &a = mBatchArtifacts[i];
+      const batch_artifact &g = global[i];
+      const consumer_store &cs = mConsumerStores[a.consumer_id];
+      auto copy = [](auto &dst, const auto &src, range from, range to) {
+        if (to.end > to.begin) {
+          std::memcpy(dst.data() + to.begin, src.data() + from.begin,
+                      (to.end - to.begin) * sizeof(src[0]));
+        }
+      };
+      copy(merged.vertices, cs.vertices, a.v, g.v);
+      copy(merged.textures, cs.textures, a.t, g.t);
+      copy(merged.normals, cs.normals, a.n, g.n);
+      copy(merged.face_tape, cs.face_tape, a.ft, g.ft);
+      copy(merged.face_bounds, cs.face_bounds, a.fb, g.fb);
+    });
+
+    mConsumerStores.clear();
+    mConsumerStores.push_back(std::move(merged));
+    mBatchArtifacts = std::move(global);
+    mContiguous = true;
+  }
+
+  // Every thread counts batches, the per-batch counts are turned into
+  // offsets by a parallel exclusive scan, then the same threads parse each
+  // batch straight into its slice of one preallocated store.
+  bool importTwoPhase() {
+    const std::size_t num_threads = mConfig.num_consumers;
+    const std::size_t nb = mBatches.size();
+    std::vector<batch_counts> counts(nb);
+    std::vector<batch_counts> offsets(nb);
+    std::vector<batch_counts> partials(num_threads);
+    batch_counts total{};
+    consumer_store global;
+    std::atomic<bool> overflow{false};
+    std::barrier sync(static_cast<std::ptrdiff_t>(num_threads));
+    std::atomic<std::size_t> next_count{0};
+    std::atomic<std::size_t> next_parse{0};
+
+    auto wait = [this, &sync]() {
+      uint64_t _t0 = rdtsc();
+      sync.arrive_and_wait();
+      mPerf.wait_cycles += (rdtsc() - _t0);
+    };
+
+    auto work = [&](std::size_t tid) {
+      for (std::size_t i = next_count++; i < nb; i = next_count++) {
+        counts[i] = scanCounts(mBatches[i].data, mBatches[i].size);
+      }
+      wait();
+
+      const std::size_t lo = nb * tid / num_threads;
+      const std::size_t hi = nb * (tid + 1) / num_threads;
+      batch_counts sum{};
+      for (std::size_t i = lo; i < hi; ++i) {
+        sum += counts[i];
+      }
+      partials[tid] = sum;
+      wait();
+
+      if (tid == 0) {
+        batch_counts run{};
+        for (batch_counts &p : partials) {
+          const batch_counts c = p;
+          p = run;
+          run += c;
+        }
+        total = run;
+
+        auto start_alloc = std::chrono::high_resolution_clock::now();
+        global.vertices.resize(total.lines.v);
+        global.textures.resize(total.lines.t);
+        global.normals.resize(total.lines.n);
+        global.face_tape.resize(total.corners);
+        global.face_bounds.resize(total.faces);
+        auto end_alloc = std::chrono::high_resolution_clock::now();
+        mPerf.alloc_time_ns +=
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end_alloc -
+                                                                 start_alloc)
+                .count();
+      }
+      wait();
+
+      batch_counts run = partials[tid];
+      for (std::size_t i = lo; i < hi; ++i) {
+        offsets[i] = run;
+        run += counts[i];
+
+        batch &b = mBatches[i];
+        b.v_seen = offsets[i].lines.v;
+        b.t_seen = offsets[i].lines.t;
+        b.n_seen = offsets[i].lines.n;
+        b.deferred = false;
+      }
+      wait();
+
+      for (std::size_t i = next_parse++; i < nb; i = next_parse++) {
+        const batch_counts &o = offsets[i];
+        const batch_counts &c = counts[i];
+        slice_store slice{
+            {global.vertices.data(), o.lines.v, o.lines.v + c.lines.v, false},
+            {global.textures.data(), o.lines.t, o.lines.t + c.lines.t, false},
+            {global.normals.data(), o.lines.n, o.lines.n + c.lines.n, false},
+            {global.face_tape.data(), o.corners, o.corners + c.corners, false},
+            {global.face_bounds.data(), o.faces, o.faces + c.faces, false},
+            {nullptr, 0, 0, false}};
+        mBatchArtifacts[i] = parseBatch(mBatches[i], slice, 0, mPerf);
+        if (slice.overflowed()) {
+          overflow = true;
+        }
+      }
+    };
+
+    mPool->run(num_threads, work);
+    if (overflow) {
+      return false;
+    }
+
+    compactSlices(global, offsets, total);
+    mConsumerStores.clear();
+    mConsumerStores.push_back(std::move(global));
+    mContiguous = true;
+    return true;
+  }
+
+  // Closes the gaps left where a batch emitted less than its counted upper
+  // bound (malformed or commented lines). Moves only run left, so a single
+  // in-order pass is safe; well-formed files skip it.
+  void compactSlices(consumer_store &global,
+                     const std::vector<batch_counts> &offsets,
+                     const batch_counts &total) {
+    const std::size_t nb = mBatchArtifacts.size();
+    bool exact = true;
+    for (std::size_t i = 0; i + 1 < nb && exact; ++i) {
+      const batch_artifact &a = mBatchArtifacts[i];
+      const batch_counts &o = offsets[i + 1];
+      exact = a.v.end == o.lines.v && a.t.end == o.lines.t &&
+              a.n.end == o.lines.n && a.ft.end == o.corners &&
+              a.fb.end == o.faces;
+    }
+    if (nb > 0 && exact) {
+      const batch_artifact &a = mBatchArtifacts[nb - 1];
+      exact = a.v.end == total.lines.v && a.t.end == total.lines.t &&
+              a.n.end == total.lines.n && a.ft.end == total.corners &&
+              a.fb.end == total.faces;
+    }
+    if (exact) {
+      return;
+    }
+
+    std::size_t v = 0, t = 0, n = 0, ft = 0, fb = 0;
+    auto shift = [](auto &arr, range &r, std::size_t &off) {
+      const std::size_t len = r.end - r.begin;
+      if (len > 0 && r.begin != off) {
+        std::memmove(arr.data() + off, arr.data() + r.begin,
+                     len * sizeof(arr[0]));
       }
+      r = range{off, off + len};
+      off += len;
     };
+    for (batch_artifact &a : mBatchArtifacts) {
+      shift(global.vertices, a.v, v);
+      shift(global.textures, a.t, t);
+      shift(global.normals, a.n, n);
+      shift(global.face_tape, a.ft, ft);
+      shift(global.face_bounds, a.fb, fb);
+    }
+    global.vertices.resize(v);
+    global.textures.resize(t);
+    global.normals.resize(n);
+    global.face_tape.resize(ft);
+    global.face_bounds.resize(fb);
+  }
+
+  // Runs format(block_sink &, job) for every job in [0, jobs) and appends
+  // the output to fd in job order. Formatting threads take jobs in order,
+  // staying at most a window of jobs ahead of this thread, which writes
+  // each finished job's blocks with writev and recycles them, so the
+  // blocks in use are bounded by the window.
+  template <class Format>
+  bool writeJobs(int fd, std::size_t jobs, const Format &format) {
+    const std::size_t threads =
+        std::min(affinityCpuCount(), std::max<std::size_t>(jobs, 1));
+    const std::size_t window = 4 * threads;
+
+    block_pool blocks;
+    std::vector<std::vector<iovec>> iovs(jobs);
+    const auto done = std::make_unique<std::atomic<bool>[]>(jobs);
+    std::atomic<std::size_t> next{0};
+    std::atomic<std::size_t> written{0};
+    std::atomic<bool> ok{true};
+
+    mPool->run(threads + 1, [&](std::size_t tid) {
+      if (tid == 0) {
+        for (std::size_t j = 0; j < jobs; ++j) {
+          done[j].wait(false, std::memory_order_acquire);
+          if (ok.load(std::memory_order_relaxed) &&
+              !writevFull(fd, iovs[j].data(), iovs[j].size())) {
+            ok.store(false, std::memory_order_relaxed);
+          }
+          for (const iovec &v : iovs[j]) {
+            blocks.release(static_cast<char *>(v.iov_base));
+          }
+          iovs[j] = {};
+          written.store(j + 1, std::memory_order_release);
+          written.notify_all();
+        }
+        return;
+      }
+
+      for (std::size_t j = next++; j < jobs; j = next++) {
+        for (std::size_t w = written.load(std::memory_order_acquire);
+             j >= w + window; w = written.load(std::memory_order_acquire)) {
+          written.wait(w, std::memory_order_acquire);
+        }
+        if (ok.load(std::memory_order_relaxed)) {
+          block_sink out(blocks, iovs[j]);
+          format(out, j);
+          out.finish();
+        }
+        done[j].store(true, std::memory_order_release);
+        done[j].notify_one();
+      }
+    });
+    return ok;
+  }
 
+  bool exportObj(int fd, const MeshExportOptions &options) {
+    const int precision = std::min(options.precision, 9);
     const std::size_t nb = mBatchArtifacts.size();
+    const bool ok =
+        writeJobs(fd, kObjRuns * nb, [&](block_sink &out, std::size_t j) {
+          formatObjRun(out, chunk(j % nb), static_cast<obj_run>(j / nb),
+                       precision);
+        });
+    return (close(fd) == 0) && ok;
+  }
 
+  // Corners index the whole mesh, so exporters that follow them need whole
+  // arrays; a chunked mesh has its chunks copied into out first.
+  template <class T>
+  std::span<const T> gather(buffer<T> &out,
+                            std::span<const T> MeshChunk::*member) const {
+    const std::size_t nb = mBatchArtifacts.size();
+    std::size_t n = 0;
     for (std::size_t bid = 0; bid < nb; ++bid) {
-      const batch_artifact &a = mBatchArtifacts[bid];
-      const consumer_store &cs = mConsumerStores[a.consumer_id];
-      for (std::size_t i = a.v.begin; i < a.v.end; ++i) {
-        if (!emitV(cs.vertices[i])) {
-          close(fd);
-          return false;
-        }
+      n += (chunk(bid).*member).size();
+    }
+    out.resize(n);
+    std::size_t off = 0;
+    for (std::size_t bid = 0; bid < nb; ++bid) {
+      const std::span<const T> arr = chunk(bid).*member;
+      std::copy(arr.begin(), arr.end(), out.begin() + off);
+      off += arr.size();
+    }
+    return out;
+  }
+
+  // Vertex records are the position arrays as they are; face records are a
+  // corner count followed by the position index of each corner.
+  bool exportPly(int fd) {
+    if constexpr (std::endian::native != std::endian::little) {
+      close(fd);
+      return false;
+    }
+
+    const consumer_sizes z = totals();
+    const std::size_t nb = mBatchArtifacts.size();
+    std::vector<idx_t> max_corners(nb);
+    parallelFor(*mPool, affinityCpuCount(), nb, [&](std::size_t bid) {
+      for (const idx_t cnt : chunk(bid).faceSizes) {
+        max_corners[bid] = std::max(max_corners[bid], cnt);
       }
+    });
+    // uchar counts, which every reader takes, unless a face needs more.
+    const bool wide = std::ranges::any_of(
+        max_corners, [](idx_t m) { return m > 0xff; });
+
+    std::string header = "ply\nformat binary_little_endian 1.0\n"
+                         "element vertex ";
+    header += std::to_string(z.v);
+    header += "\nproperty float x\nproperty float y\nproperty float z\n"
+              "element face ";
+    header += std::to_string(z.fb);
+    header += wide ? "\nproperty list uint uint vertex_indices\n"
+                   : "\nproperty list uchar uint vertex_indices\n";
+    header += "end_header\n";
+
+    const bool ok =
+        writeFull(fd, header.data(), header.size()) &&
+        writeJobs(fd, 2 * nb, [&](block_sink &out, std::size_t j) {
+          const MeshChunk c = chunk(j % nb);
+          if (j < nb) {
+            out.append(c.positions.data(), c.positions.size_bytes());
+            return;
+          }
+          std::size_t ft = 0;
+          for (const idx_t cnt : c.faceSizes) {
+            if (wide) {
+              out.append(&cnt, sizeof(cnt));
+            } else {
+              const uint8_t cnt8 = static_cast<uint8_t>(cnt);
+              out.append(&cnt8, 1);
+            }
+            for (std::size_t k = 0; k < cnt; ++k) {
+              char *p = out.room(sizeof(idx_t));
+              std::memcpy(p, &c.faceVertices[ft++].i, sizeof(idx_t));
+              out.commit(p + sizeof(idx_t));
+            }
+          }
+        });
+    return (close(fd) == 0) && ok;
+  }
+
+  // Faces with more than three corners are fanned into triangles; faces
+  // with fewer are dropped. Corners whose position index is out of range
+  // land at the origin.
+  bool exportStl(int fd) {
+    if constexpr (std::endian::native != std::endian::little) {
+      close(fd);
+      return false;
     }
 
-    for (std::size_t bid = 0; bid < nb; ++bid) {
-      const batch_artifact &a = mBatchArtifacts[bid];
-      const consumer_store &cs = mConsumerStores[a.consumer_id];
-      for (std::size_t i = a.t.begin; i < a.t.end; ++i) {
-        if (!emitVT(cs.textures[i])) {
-          close(fd);
-          return false;
-        }
+    const std::size_t nb = mBatchArtifacts.size();
+    std::vector<uint64_t> tris(nb);
+    parallelFor(*mPool, affinityCpuCount(), nb, [&](std::size_t bid) {
+      for (const idx_t cnt : chunk(bid).faceSizes) {
+        tris[bid] += cnt > 2 ? cnt - 2 : 0;
       }
+    });
+    const uint64_t total = std::accumulate(tris.begin(), tris.end(), 0ull);
+    if (total > std::numeric_limits<uint32_t>::max()) {
+      close(fd);
+      return false;
     }
 
-    for (std::size_t bid = 0; bid < nb; ++bid) {
-      const batch_artifact &a = mBatchArtifacts[bid];
-      const consumer_store &cs = mConsumerStores[a.consumer_id];
-      for (std::size_t i = a.n.begin; i < a.n.end; ++i) {
-        if (!emitVN(cs.normals[i])) {
-          close(fd);
-          return false;
+    buffer<vec3f> pos_scratch;
+    const std::span<const vec3f> pos =
+        mContiguous ? view(0).vertices
+                    : gather(pos_scratch, &MeshChunk::positions);
+
+    char header[84] = "binary STL written by mesh-lib";
+    const uint32_t count = static_cast<uint32_t>(total);
+    std::memcpy(header + 80, &count, sizeof(count));
+
+    const bool ok =
+        writeFull(fd, header, sizeof(header)) &&
+        writeJobs(fd, nb, [&](block_sink &out, std::size_t bid) {
+          const MeshChunk c = chunk(bid);
+          auto at = [&](const vec3i &corner) {
+            return corner.i < pos.size() ? pos[corner.i] : vec3f{0, 0, 0};
+          };
+          std::size_t ft = 0;
+          for (const idx_t cnt : c.faceSizes) {
+            const vec3f a = cnt > 2 ? at(c.faceVertices[ft]) : vec3f{};
+            for (std::size_t k = 2; k < cnt; ++k) {
+              const vec3f b = at(c.faceVertices[ft + k - 1]);
+              const vec3f d = at(c.faceVertices[ft + k]);
+              // normal, three corners, attribute byte count
+              float rec[12] = {0, 0, 0, a.x, a.y, a.z, b.x, b.y, b.z,
+                               d.x, d.y, d.z};
+              const float ux = b.x - a.x, uy = b.y - a.y, uz = b.z - a.z;
+              const float vx = d.x - a.x, vy = d.y - a.y, vz = d.z - a.z;
+              const float nx = uy * vz - uz * vy, ny = uz * vx - ux * vz,
+                          nz = ux * vy - uy * vx;
+              const float len = std::sqrt(nx * nx + ny * ny + nz * nz);
+              if (len > 0) {
+                rec[0] = nx / len;
+                rec[1] = ny / len;
+                rec[2] = nz / len;
+              }
+              char *p = out.room(50);
+              std::memcpy(p, rec, sizeof(rec));
+              std::memset(p + sizeof(rec), 0, 2);
+              out.commit(p + 50);
+            }
+            ft += cnt;
+          }
+        });
+    return (close(fd) == 0) && ok;
+  }
+
+  // Faces are fanned into triangles over deduplicated vertices that
+  // interleave position, normal and texcoord. glTF normals must be unit
+  // length, so they are written only when every corner has a nonzero one,
+  // and normalized. Texcoords are written when the mesh has any, as (0, 0)
+  // for corners without one, flipped to glTF's top-left origin.
+  bool exportGlb(int fd) {
+    if constexpr (std::endian::native != std::endian::little) {
+      close(fd);
+      return false;
+    }
+
+    const std::size_t nb = mBatchArtifacts.size();
+    const std::size_t threads = affinityCpuCount();
+    std::vector<std::size_t> tri_base(nb + 1), corner_base(nb + 1);
+    parallelFor(*mPool, threads, nb, [&](std::size_t bid) {
+      const MeshChunk c = chunk(bid);
+      for (const idx_t cnt : c.faceSizes) {
+        tri_base[bid + 1] += cnt > 2 ? cnt - 2 : 0;
+      }
+      corner_base[bid + 1] = c.faceVertices.size();
+    });
+    std::partial_sum(tri_base.begin(), tri_base.end(), tri_base.begin());
+    std::partial_sum(corner_base.begin(), corner_base.end(),
+                     corner_base.begin());
+    const std::size_t tris = tri_base[nb];
+    const std::size_t corners = corner_base[nb];
+    if (tris == 0 || corners >= std::numeric_limits<uint32_t>::max()) {
+      close(fd);
+      return false;
+    }
+
+    // Scatter the corners into partitions chunk by chunk, in file order,
+    // so the vertex numbering does not depend on the thread count.
+    const std::size_t parts = std::size_t{1} << kGlbPartitionBits;
+    auto partOf = [](uint64_t h) {
+      return static_cast<std::size_t>(h >> (64 - kGlbPartitionBits));
+    };
+    std::vector<std::size_t> offsets(nb * parts);
+    parallelFor(*mPool, threads, nb, [&](std::size_t bid) {
+      for (const vec3i &key : chunk(bid).faceVertices) {
+        ++offsets[bid * parts + partOf(hashCorner(key))];
+      }
+    });
+    std::vector<std::size_t> part_begin(parts + 1);
+    for (std::size_t p = 0, run = 0; p < parts; ++p) {
+      part_begin[p] = run;
+      for (std::size_t bid = 0; bid < nb; ++bid) {
+        std::size_t &o = offsets[bid * parts + p];
+        const std::size_t n = o;
+        o = run;
+        run += n;
+      }
+      part_begin[p + 1] = run;
+    }
+    buffer<glb_corner> scattered(corners);
+    parallelFor(*mPool, threads, nb, [&](std::size_t bid) {
+      std::size_t *off = &offsets[bid * parts];
+      const std::span<const vec3i> tape = chunk(bid).faceVertices;
+      for (std::size_t k = 0; k < tape.size(); ++k) {
+        scattered[off[partOf(hashCorner(tape[k]))]++] = {
+            tape[k], static_cast<uint32_t>(corner_base[bid] + k)};
+      }
+    });
+
+    // Number the distinct triples of each partition, then offset each
+    // partition's numbers by the vertices of the partitions before it.
+    std::vector<std::vector<vec3i>> keys(parts);
+    buffer<uint32_t> corner_vertex(corners);
+    parallelFor(*mPool, threads, parts, [&](std::size_t p) {
+      corner_table table(part_begin[p + 1] - part_begin[p]);
+      for (std::size_t e = part_begin[p]; e < part_begin[p + 1]; ++e) {
+        const glb_corner &gc = scattered[e];
+        corner_vertex[gc.corner] =
+            table.insert(gc.key, hashCorner(gc.key), keys[p]);
+      }
+    });
+    std::vector<std::size_t> vertex_base(parts + 1);
+    for (std::size_t p = 0; p < parts; ++p) {
+      vertex_base[p + 1] = vertex_base[p] + keys[p].size();
+    }
+    parallelFor(*mPool, threads, parts, [&](std::size_t p) {
+      for (std::size_t e = part_begin[p]; e < part_begin[p + 1]; ++e) {
+        corner_vertex[scattered[e].corner] +=
+            static_cast<uint32_t>(vertex_base[p]);
+      }
+    });
+    buffer<glb_corner>().swap(scattered);
+    const std::size_t nv = vertex_base[parts];
+
+    const consumer_sizes z = totals();
+    const bool has_t = z.t > 0;
+    buffer<vec3f> pos_scratch, nrm_scratch;
+    buffer<vec2f> tex_scratch;
+    const store_view whole = mContiguous ? view(0) : store_view{};
+    const std::span<const vec3f> pos =
+        mContiguous ? whole.vertices
+                    : gather(pos_scratch, &MeshChunk::positions);
+    const std::span<const vec3f> nrm =
+        z.n == 0 || mContiguous ? whole.normals
+                                : gather(nrm_scratch, &MeshChunk::normals);
+    std::vector<char> part_has_n(parts, 1);
+    parallelFor(*mPool, threads, z.n > 0 ? parts : 0, [&](std::size_t p) {
+      for (const vec3i &key : keys[p]) {
+        const vec3f n = key.k < nrm.size() ? nrm[key.k] : vec3f{};
+        if (!(n.x * n.x + n.y * n.y + n.z * n.z > 0)) {
+          part_has_n[p] = 0;
+          return;
         }
       }
+    });
+    const bool has_n =
+        z.n > 0 && std::find(part_has_n.begin(), part_has_n.end(), 0) ==
+                       part_has_n.end();
+    const std::span<const vec2f> tex =
+        !has_t || mContiguous ? whole.textures
+                              : gather(tex_scratch, &MeshChunk::texcoords);
+    auto positionOf = [&](const vec3i &key) {
+      return key.i < pos.size() ? pos[key.i] : vec3f{};
+    };
+
+    // glTF requires the bounds of the positions.
+    std::vector<std::array<float, 6>> part_bounds(parts);
+    parallelFor(*mPool, threads, parts, [&](std::size_t p) {
+      std::array<float, 6> b = {std::numeric_limits<float>::max(),
+                                std::numeric_limits<float>::max(),
+                                std::numeric_limits<float>::max(),
+                                std::numeric_limits<float>::lowest(),
+                                std::numeric_limits<float>::lowest(),
+                                std::numeric_limits<float>::lowest()};
+      for (const vec3i &key : keys[p]) {
+        const vec3f v = positionOf(key);
+        b = {std::min(b[0], v.x), std::min(b[1], v.y), std::min(b[2], v.z),
+             std::max(b[3], v.x), std::max(b[4], v.y), std::max(b[5], v.z)};
+      }
+      part_bounds[p] = b;
+    });
+    std::array<float, 6> bounds = part_bounds[0];
+    for (const std::array<float, 6> &b : part_bounds) {
+      for (int a = 0; a < 3; ++a) {
+        bounds[a] = std::min(bounds[a], b[a]);
+        bounds[a + 3] = std::max(bounds[a + 3], b[a + 3]);
+      }
+    }
+
+    const std::size_t stride = 12 + (has_n ? 12 : 0) + (has_t ? 8 : 0);
+    const std::size_t vertex_bytes = nv * stride;
+    const std::size_t index_offset =
+        (vertex_bytes + kGlbViewAlign - 1) & ~(kGlbViewAlign - 1);
+    const std::size_t index_bytes = 3 * tris * sizeof(uint32_t);
+    const std::size_t bin_bytes = index_offset + index_bytes;
+
+    std::string json = R"({"asset":{"version":"2.0","generator":"mesh-lib"},)"
+                       R"("scene":0,"scenes":[{"nodes":[0]}],)"
+                       R"("nodes":[{"mesh":0}],"meshes":[{"primitives":)"
+                       R"([{"attributes":{"POSITION":0)";
+    std::size_t accessor = 1;
+    if (has_n) {
+      json += ",\"NORMAL\":" + std::to_string(accessor++);
+    }
+    if (has_t) {
+      json += ",\"TEXCOORD_0\":" + std::to_string(accessor++);
+    }
+    json += "},\"indices\":" + std::to_string(accessor) + ",\"mode\":4}]}],";
+    json += "\"buffers\":[{\"byteLength\":" + std::to_string(bin_bytes) + "}],";
+    json += "\"bufferViews\":[{\"buffer\":0,\"byteOffset\":0,\"byteLength\":" +
+            std::to_string(vertex_bytes) +
+            ",\"byteStride\":" + std::to_string(stride) +
+            ",\"target\":34962},{\"buffer\":0,\"byteOffset\":" +
+            std::to_string(index_offset) +
+            ",\"byteLength\":" + std::to_string(index_bytes) +
+            ",\"target\":34963}],";
+    json += "\"accessors\":[{\"bufferView\":0,\"componentType\":5126,"
+            "\"count\":" + std::to_string(nv) + ",\"type\":\"VEC3\",\"min\":[";
+    for (int a = 0; a < 3; ++a) {
+      json += a ? "," : "";
+      appendJsonFloat(json, bounds[a]);
+    }
+    json += "],\"max\":[";
+    for (int a = 3; a < 6; ++a) {
+      json += a > 3 ? "," : "";
+      appendJsonFloat(json, bounds[a]);
+    }
+    json += "]}";
+    std::size_t attr_offset = 12;
+    if (has_n) {
+      json += ",{\"bufferView\":0,\"byteOffset\":12,\"componentType\":5126,"
+              "\"count\":" + std::to_string(nv) + ",\"type\":\"VEC3\"}";
+      attr_offset += 12;
+    }
+    if (has_t) {
+      json += ",{\"bufferView\":0,\"byteOffset\":" +
+              std::to_string(attr_offset) +
+              ",\"componentType\":5126,\"count\":" + std::to_string(nv) +
+              ",\"type\":\"VEC2\"}";
+    }
+    json += ",{\"bufferView\":1,\"componentType\":5125,\"count\":" +
+            std::to_string(3 * tris) + ",\"type\":\"SCALAR\"}]}";
+    json.resize((json.size() + 3) & ~std::size_t{3}, ' ');
+
+    const std::size_t total = 12 + 8 + json.size() + 8 + bin_bytes;
+    if (total > std::numeric_limits<uint32_t>::max()) {
+      close(fd);
+      return false;
+    }
+    std::string head(20, '\0');
+    const uint32_t fields[] = {kGlbMagic, 2, static_cast<uint32_t>(total),
+                               static_cast<uint32_t>(json.size()),
+                               kGlbJsonChunk};
+    std::memcpy(head.data(), fields, sizeof(fields));
+    head += json;
+    const uint32_t bin_fields[] = {static_cast<uint32_t>(bin_bytes),
+                                   kGlbBinChunk};
+    head.append(reinterpret_cast<const char *>(bin_fields),
+                sizeof(bin_fields));
+
+    // One job per partition of vertices, one for the padding in front of
+    // the indices, then one per chunk of faces.
+    const bool ok =
+        writeFull(fd, head.data(), head.size()) &&
+        writeJobs(fd, parts + 1 + nb, [&](block_sink &out, std::size_t j) {
+          if (j < parts) {
+            for (const vec3i &key : keys[j]) {
+              float rec[8];
+              std::size_t n = 0;
+              const vec3f v = positionOf(key);
+              rec[n++] = v.x;
+              rec[n++] = v.y;
+              rec[n++] = v.z;
+              if (has_n) {
+                const vec3f nv3 = nrm[key.k];
+                const float len =
+                    std::sqrt(nv3.x * nv3.x + nv3.y * nv3.y + nv3.z * nv3.z);
+                rec[n++] = nv3.x / len;
+                rec[n++] = nv3.y / len;
+                rec[n++] = nv3.z / len;
+              }
+              if (has_t) {
+                const vec2f t = key.j < tex.size() ? tex[key.j] : vec2f{0, 1};
+                rec[n++] = t.u;
+                rec[n++] = 1.0f - t.v;
+              }
+              out.append(rec, n * sizeof(float));
+            }
+            return;
+          }
+          if (j == parts) {
+            static constexpr char zeros[kGlbViewAlign] = {};
+            out.append(zeros, index_offset - vertex_bytes);
+            return;
+          }
+          const std::size_t bid = j - parts - 1;
+          const uint32_t *cv = corner_vertex.data() + corner_base[bid];
+          for (const idx_t cnt : chunk(bid).faceSizes) {
+            for (std::size_t k = 2; k < cnt; ++k) {
+              const uint32_t tri[3] = {cv[0], cv[k - 1], cv[k]};
+              char *p = out.room(sizeof(tri));
+              std::memcpy(p, tri, sizeof(tri));
+              out.commit(p + sizeof(tri));
+            }
+            cv += cnt;
+          }
+        });
+    return (close(fd) == 0) && ok;
+  }
+
+  bool saveBinary(int fd) const {
+    if constexpr (std::endian::native != std::endian::little) {
+      close(fd);
+      return false;
+    }
+
+    const consumer_sizes z = totals();
+    const std::size_t nb = mBatchArtifacts.size();
+    const std::array<std::size_t, BinSections> counts = {z.v,  z.t,  z.n,
+                                                         z.ft, z.fb, nb};
+    bin_header h{};
+    std::memcpy(h.magic, kBinMagic, sizeof(kBinMagic));
+    h.version = kBinVersion;
+    h.header_size = sizeof(bin_header);
+    std::size_t off = alignBin(sizeof(bin_header));
+    for (std::size_t s = 0; s < BinSections; ++s) {
+      h.sections[s] = {off, counts[s]};
+      off = alignBin(off + counts[s] * kBinElemSize[s]);
     }
+    h.file_size = off;
 
+    std::vector<bin_chunk> chunks(nb);
     for (std::size_t bid = 0; bid < nb; ++bid) {
       const batch_artifact &a = mBatchArtifacts[bid];
-      const consumer_store &cs = mConsumerStores[a.consumer_id];
+      chunks[bid] = {a.v.end - a.v.begin, a.t.end - a.t.begin,
+                     a.n.end - a.n.begin, a.ft.end - a.ft.begin,
+                     a.fb.end - a.fb.begin};
+    }
 
-      std::size_t ft = a.ft.begin;
-      for (std::size_t fb = a.fb.begin; fb < a.fb.end; ++fb) {
-        const std::size_t cnt = cs.face_bounds[fb];
-        out += "f";
-        for (std::size_t k = 0; k < cnt; ++k) {
-          emitFaceVertex(cs.face_tape[ft++]);
-        }
-        out += "\n";
-        if (!flushIf()) {
-          close(fd);
-          return false;
+    bool ok = writeFull(fd, &h, sizeof(h));
+    std::size_t pos = sizeof(h);
+    auto padTo = [&](std::size_t target) {
+      static constexpr char zeros[kBinAlign] = {};
+      ok = ok && writeFull(fd, zeros, target - pos);
+      pos = target;
+    };
+    // Chunks that sit back to back in memory (all of them once merged) go
+    // out in one write.
+    auto putSection = [&](bin_section s, auto MeshChunk::*member) {
+      padTo(h.sections[s].offset);
+      const char *run = nullptr;
+      std::size_t run_bytes = 0;
+      for (std::size_t bid = 0; bid < nb && ok; ++bid) {
+        const auto arr = chunk(bid).*member;
+        const char *p = reinterpret_cast<const char *>(arr.data());
+        if (run + run_bytes != p) {
+          ok = writeFull(fd, run, run_bytes);
+          run = p;
+          run_bytes = 0;
         }
+        run_bytes += arr.size_bytes();
       }
+      ok = ok && writeFull(fd, run, run_bytes);
+      pos += counts[s] * kBinElemSize[s];
+    };
+    putSection(BinPositions, &MeshChunk::positions);
+    putSection(BinTexcoords, &MeshChunk::texcoords);
+    putSection(BinNormals, &MeshChunk::normals);
+    putSection(BinFaceTape, &MeshChunk::faceVertices);
+    putSection(BinFaceBounds, &MeshChunk::faceSizes);
+    padTo(h.sections[BinChunks].offset);
+    ok = ok && writeFull(fd, chunks.data(), nb * sizeof(bin_chunk));
+    pos += nb * sizeof(bin_chunk);
+    padTo(h.file_size);
+
+    return (close(fd) == 0) && ok;
+  }
+
+  // Publishes this mesh as cache entry path. The file is written under a
+  // temporary name and renamed into place, so concurrent importers never
+  // map a partial entry.
+  bool saveCacheEntry(const std::string &path) const {
+    std::string tmp = path + ".XXXXXX";
+    const int fd = mkstemp(tmp.data());
+    if (fd == -1) {
+      return false;
+    }
+    fchmod(fd, 0644);
+    if (!saveBinary(fd) || rename(tmp.c_str(), path.c_str()) != 0) {
+      unlink(tmp.c_str());
+      return false;
     }
+    return true;
+  }
 
-    if (!out.empty() && !flushFd(fd, out)) {
-      close(fd);
+  // Maps a saveBinary file and views it in place; the header and section
+  // bounds are checked, the arrays are trusted. Leaves the current mesh
+  // alone on failure.
+  bool loadBinary(int fd) {
+    if constexpr (std::endian::native != std::endian::little) {
+      return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 ||
+        static_cast<std::size_t>(st.st_size) < sizeof(bin_header)) {
+      return false;
+    }
+    const std::size_t size = static_cast<std::size_t>(st.st_size);
+    void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      return false;
+    }
+    auto mapping = std::make_unique<file_mapping>(p, size);
+    const char *base = static_cast<const char *>(p);
+
+    bin_header h;
+    std::memcpy(&h, base, sizeof(h));
+    if (std::memcmp(h.magic, kBinMagic, sizeof(kBinMagic)) != 0 ||
+        h.version != kBinVersion || h.header_size != sizeof(bin_header) ||
+        h.file_size != size) {
       return false;
     }
-    return (close(fd) == 0);
+    for (std::size_t s = 0; s < BinSections; ++s) {
+      const uint64_t off = h.sections[s].offset;
+      if (off % kBinAlign != 0 || off < sizeof(bin_header) || off > size ||
+          h.sections[s].count > (size - off) / kBinElemSize[s]) {
+        return false;
+      }
+    }
+
+    // Rebuild the batch ranges over the single store the file describes.
+    const std::span<const bin_chunk> chunks =
+        binSection<bin_chunk>(base, h, BinChunks);
+    std::vector<batch_artifact> artifacts(chunks.size());
+    std::array<uint64_t, BinChunks> at{};
+    auto take = [&](range &r, bin_section s, uint64_t n) {
+      if (n > h.sections[s].count - at[s]) {
+        return false;
+      }
+      r = {at[s], at[s] + n};
+      at[s] += n;
+      return true;
+    };
+    for (std::size_t bid = 0; bid < chunks.size(); ++bid) {
+      const bin_chunk &c = chunks[bid];
+      batch_artifact &a = artifacts[bid];
+      a.batch_id = bid;
+      a.consumer_id = 0;
+      a.fx = {};
+      a.lines = {c.v, c.t, c.n};
+      if (!take(a.v, BinPositions, c.v) || !take(a.t, BinTexcoords, c.t) ||
+          !take(a.n, BinNormals, c.n) || !take(a.ft, BinFaceTape, c.ft) ||
+          !take(a.fb, BinFaceBounds, c.fb)) {
+        return false;
+      }
+    }
+    for (std::size_t s = 0; s < BinChunks; ++s) {
+      if (at[s] != h.sections[s].count) {
+        return false;
+      }
+    }
+
+    reset();
+    mConsumerStores.clear();
+    mBatchArtifacts = std::move(artifacts);
+    mContiguous = true;
+    mMapped = {binSection<vec3f>(base, h, BinPositions),
+               binSection<vec2f>(base, h, BinTexcoords),
+               binSection<vec3f>(base, h, BinNormals),
+               binSection<vec3i>(base, h, BinFaceTape),
+               binSection<idx_t>(base, h, BinFaceBounds)};
+    mMapping = std::move(mapping);
+    return true;
   }
 
-  void printStats(double total_sec, std::size_t file_size) {
+  // Only OBJ imports fill the parse counters in mPerf.
+  void printStats(double total_sec, std::size_t file_size,
+                  bool parse_counters = true) {
     double gb = file_size / (1024.0 * 1024.0 * 1024.0);
     double throughput = gb / total_sec;
 
     std::cout << "\n--------- PERF REPORT ---------\n";
     std::cout << "Throughput: " << std::fixed << std::setprecision(2)
               << throughput << " GB/s\n";
+    if (!parse_counters) {
+      std::cout << "-------------------------------\n";
+      return;
+    }
     std::cout << "Wait Ratio: "
-              << (double)g_perf.wait_cycles / g_perf.parse_cycles * 100.0
+              << (double)mPerf.wait_cycles / mPerf.parse_cycles * 100.0
               << "%\n";
 
-    if (g_perf.wait_cycles > g_perf.parse_cycles * 0.2) {
+    if (mPerf.wait_cycles > mPerf.parse_cycles * 0.2) {
       std::cout
           << "[HINT] High Wait Ratio: Producer is too slow or batch_size is "
-             "too small. "
-          << "The linear scan in prefixCounts is likely the bottleneck.\n";
+             "too small.\n";
     }
 
     double cycles_per_byte =
-        (double)g_perf.parse_cycles / g_perf.bytes_processed;
+        (double)mPerf.parse_cycles / mPerf.bytes_processed;
     std::cout << "Cycles/Byte: " << cycles_per_byte << "\n";
 
     if (cycles_per_byte > 10.0) {
-      std::cout << "[HINT] High Cycles/Byte: Check for branch mispredictions "
-                   "in classifyLine "
-                << "or SIMD-ify parseFloat.\n";
+      std::cout << "[HINT] High Cycles/Byte: Check for lines longer than "
+                   "64 bytes "
+                << "or non fixed-format numbers leaving the SIMD path.\n";
     }
 
-    std::cout << "Alloc/Reserve: " << g_perf.alloc_time_ns / 1e6 << " ms\n";
+    std::cout << "Alloc/Reserve: " << mPerf.alloc_time_ns / 1e6 << " ms\n";
     std::cout << "-------------------------------\n";
   }
 };
 
-Mesh::Mesh() {
-  mesh_config config;
-  config.batch_size = 256 * 1024;
-  config.num_consumers = std::thread::hardware_concurrency() > 4
-                             ? std::thread::hardware_concurrency() - 4
-                             : 2;
-  config.queue_capacity = 4 * config.num_consumers;
-  _impl = std::make_unique<_MeshImpl>(config);
-}
+Mesh::Mesh() : Mesh(ThreadPool::global()) {}
+
+Mesh::Mesh(ThreadPool &pool) : _impl(std::make_unique<_MeshImpl>(pool)) {}
 Mesh::~Mesh() = default;
 
-bool Mesh::importObj(const char *path) {
+bool Mesh::importObj(const char *path, const MeshImportOptions &options) {
+  int fd = -1;
+  if (options.io == MeshImportIo::Read && options.directIo) {
+    fd = open(path, O_RDONLY | O_DIRECT);
+  }
+  if (fd == -1) {
+    fd = open(path, O_RDONLY);
+  }
+  if (fd == -1) {
+    return false;
+  }
+
+  struct stat st;
+  std::string entry;
+  if (options.cacheDir && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+    entry = cacheEntryPath(options.cacheDir, st);
+    if (loadBinary(entry.c_str())) {
+      close(fd);
+      return true;
+    }
+  }
+
+  const bool ok = importObj(fd, options);
+  // Skip the entry if the file changed under the import.
+  struct stat after;
+  if (ok && !entry.empty() && fstat(fd, &after) == 0 &&
+      sameFileVersion(st, after)) {
+    _impl->saveCacheEntry(entry);
+  }
+  close(fd);
+  return ok;
+}
+
+bool Mesh::importPly(const char *path, const MeshImportOptions &options) {
   int fd = open(path, O_RDONLY);
   if (fd == -1) {
     return false;
   }
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size == 0) {
+    close(fd);
+    return false;
+  }
+  const std::size_t file_size = static_cast<std::size_t>(st.st_size);
+  void *ply = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE,
+                   fd, 0);
+  close(fd);
+  if (ply == MAP_FAILED) {
+    return false;
+  }
 
-  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  const bool ok =
+      _impl->importPly(static_cast<const char *>(ply), file_size, options);
+  return (munmap(ply, file_size) == 0) && ok;
+}
+
+bool Mesh::importObj(std::span<const char> data,
+                     const MeshImportOptions &options) {
+  if (data.empty()) {
+    return false;
+  }
+  return _impl->importObj(data.data(), data.size(), options);
+}
 
+bool Mesh::importObj(int fd, const MeshImportOptions &options) {
   struct stat st;
   if (fstat(fd, &st) == -1) {
-    close(fd);
     return false;
   }
+  if (!S_ISREG(st.st_mode)) {
+    return _impl->importRead(fd, kUnknownSize, options);
+  }
+
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
 
-  readahead(fd, 0, st.st_size);
   std::size_t file_size = static_cast<std::size_t>(st.st_size);
   if (file_size == 0) {
-    close(fd);
     return false;
   }
 
-  void *obj =
-      mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
-  close(fd);
+  // Compressed files are decompressed from a mapping, whatever options.io
+  // says. The buffer is aligned in case fd was opened with O_DIRECT.
+  if (options.io == MeshImportIo::Read) {
+    alignas(4096) char head[4096];
+    const ssize_t n = pread(fd, head, sizeof(head), 0);
+    if (n < 0 || detectCompression(head, static_cast<std::size_t>(n)) ==
+                     compression::None) {
+      return _impl->importRead(fd, file_size, options);
+    }
+  }
+
+  // A streamed import faults its window in as it goes instead.
+  const bool stream = options.streamWindow != 0;
+  if (!stream) {
+    readahead(fd, 0, st.st_size);
+  }
+  void *obj = mmap(nullptr, file_size, PROT_READ,
+                   MAP_PRIVATE | (stream ? 0 : MAP_POPULATE), fd, 0);
   if (obj == MAP_FAILED) {
     return false;
   }
 
   madvise(obj, file_size, MADV_SEQUENTIAL);
-  madvise(obj, file_size, MADV_WILLNEED);
-
-  std::size_t num_batches = 0;
-  {
-    const char *data = static_cast<const char *>(obj);
-    std::size_t off = 0;
-    while (off < file_size) {
-      (void)build_range(data, file_size, off, _impl->mConfig.batch_size);
-      ++num_batches;
-    }
+  if (!stream) {
+    madvise(obj, file_size, MADV_WILLNEED);
   }
-  _impl->mBatchArtifacts.resize(num_batches);
-  _impl->mBatches.resize(num_batches);
 
-  auto start_time = std::chrono::high_resolution_clock::now();
-  if (!_impl->importObj(obj, file_size)) {
+  if (!_impl->importObj(obj, file_size, options, true)) {
     munmap(obj, file_size);
     return false;
   }
-  auto end_time = std::chrono::high_resolution_clock::now();
-  std::chrono::duration<double> diff = end_time - start_time;
-  double total_sec = diff.count();
-  _impl->printStats(total_sec, file_size);
-
   return (munmap(obj, file_size) == 0);
 }
 
-bool Mesh::exportObj(const char *path) const {
+bool Mesh::exportObj(const char *path,
+                     const MeshExportOptions &options) const {
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    return false;
+  }
+  return _impl->exportObj(fd, options);
+}
+
+bool Mesh::exportPly(const char *path) const {
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    return false;
+  }
+  return _impl->exportPly(fd);
+}
+
+bool Mesh::exportStl(const char *path) const {
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    return false;
+  }
+  return _impl->exportStl(fd);
+}
+
+bool Mesh::exportGlb(const char *path) const {
   int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
   if (fd == -1) {
     return false;
   }
-  return _impl->exportObj(fd);
+  return _impl->exportGlb(fd);
 }
+
+bool Mesh::saveBinary(const char *path) const {
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    return false;
+  }
+  return _impl->saveBinary(fd);
+}
+
+bool Mesh::loadBinary(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    return false;
+  }
+  const bool ok = _impl->loadBinary(fd);
+  close(fd);
+  return ok;
+}
+
+bool Mesh::isContiguous() const { return _impl->mContiguous; }
+
+std::span<const vec3f> Mesh::positions() const {
+  if (!isContiguous()) {
+    return {};
+  }
+  return _impl->view(0).vertices;
+}
+
+std::span<const vec2f> Mesh::texcoords() const {
+  if (!isContiguous()) {
+    return {};
+  }
+  return _impl->view(0).textures;
+}
+
+std::span<const vec3f> Mesh::normals() const {
+  if (!isContiguous()) {
+    return {};
+  }
+  return _impl->view(0).normals;
+}
+
+std::span<const vec3i> Mesh::faceVertices() const {
+  if (!isContiguous()) {
+    return {};
+  }
+  return _impl->view(0).face_tape;
+}
+
+std::span<const idx_t> Mesh::faceSizes() const {
+  if (!isContiguous()) {
+    return {};
+  }
+  return _impl->view(0).face_bounds;
+}
+
+std::size_t Mesh::numPositions() const { return _impl->totals().v; }
+std::size_t Mesh::numTexcoords() const { return _impl->totals().t; }
+std::size_t Mesh::numNormals() const { return _impl->totals().n; }
+std::size_t Mesh::numFaces() const { return _impl->totals().fb; }
+std::size_t Mesh::numFaceVertices() const { return _impl->totals().ft; }
+
+std::size_t Mesh::numChunks() const { return _impl->mBatchArtifacts.size(); }
+
+MeshChunk Mesh::chunk(std::size_t i) const { return _impl->chunk(i); }